@@ -0,0 +1,433 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <unistd.h>
+
+#include "types.h"
+#include "bitboard.h"
+#include "position.h"
+#include "movegen.h"
+#include "make_unmake.cpp"
+#include "pawns.h"
+#include "search.h"
+#ifdef NNUE
+#include "nnue.h"
+#endif
+
+/*
+Micro benchmarks for single building blocks of the engine. The full
+engine is measured with perft and test, these are meant for comparing
+the build options against each other.
+*/
+
+// Cache sizes as reported by the OS, 0 if unknown
+inline long cache_size(int name){
+    long size = sysconf(name);
+    return size > 0 ? size : 0;
+}
+
+inline void print_footprint(size_t bytes){
+    long l1 = cache_size(_SC_LEVEL1_DCACHE_SIZE);
+    long l2 = cache_size(_SC_LEVEL2_CACHE_SIZE);
+
+    std::cout << "  Footprint: " << bytes/1024.0 << " KB";
+    if(l1) std::cout << ", " << (bytes*100.0)/l1 << "% of L1 (" << l1/1024 << " KB)";
+    if(l2) std::cout << ", " << (bytes*100.0)/l2 << "% of L2 (" << l2/1024 << " KB)";
+    std::cout << std::endl;
+}
+
+// Looks up random squares and blockers. Independent lookups measure the
+// throughput, in the dependent run every blocker board depends on the last
+// result, which shows the latency of a lookup
+template <typename Lookup>
+void bench_lookup(const std::string& name, Lookup lookup, Bitboard (*reference)(Square, Bitboard)){
+    constexpr int samples = 1 << 16;
+    constexpr int rounds = 100;
+
+    std::vector<Square> squares(samples);
+    std::vector<Bitboard> blockers(samples);
+
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    auto next_random = [&seed](){
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return seed;
+    };
+
+    for(int i = 0; i < samples; i++){
+        squares[i] = next_random() & 63;
+        // About a quarter of the squares occupied, like in a middlegame
+        blockers[i] = next_random() & next_random();
+    }
+
+    int errors = 0;
+    for(int i = 0; i < samples; i++){
+        if(lookup(squares[i], blockers[i]) != reference(squares[i], blockers[i])) errors++;
+    }
+
+    Bitboard sink = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int r = 0; r < rounds; r++){
+        for(int i = 0; i < samples; i++){
+            sink ^= lookup(squares[i], blockers[i]);
+        }
+    }
+    auto mid = std::chrono::high_resolution_clock::now();
+    for(int r = 0; r < rounds; r++){
+        for(int i = 0; i < samples; i++){
+            sink = lookup(squares[i], blockers[i] ^ (sink & 1));
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    double independent = std::chrono::duration<double, std::nano>(mid - start).count()/(1.0*samples*rounds);
+    double dependent = std::chrono::duration<double, std::nano>(stop - mid).count()/(1.0*samples*rounds);
+
+    std::cout << "  " << name << ": " << independent << " ns/lookup, "
+              << dependent << " ns/lookup dependent, "
+              << errors << " errors" << std::endl;
+
+    // Keeps the loops from being optimized away
+    volatile Bitboard result = sink;
+    (void)result;
+}
+
+void bench_slider_attacks(){
+    std::cout << "Slider attacks, backend: " << slider_backend_name << std::endl;
+
+    bench_lookup("Rook  ", [](Square sq, Bitboard blockers){return get_rook_attack_BB(sq, blockers);},
+                gen_rook_attacks);
+    bench_lookup("Bishop", [](Square sq, Bitboard blockers){return get_bishop_attack_BB(sq, blockers);},
+                gen_bishop_attacks);
+
+    print_footprint(slider_footprint);
+}
+
+// Positions for the benchmarks that need a whole board
+const std::array<std::string, 6> bench_fens = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "2r3k1/1q1nbppp/r3p3/3pP3/pPpP4/P1Q2N2/2RN1PPP/2R4K b - - 0 22",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "4k3/8/8/8/8/8/8/R3K2R w KQ - 0 1"
+};
+
+// Attacked squares the way it was done before the set-wise maps, one lookup per piece
+template <PieceColor side>
+Bitboard attacked_squares_by_lookup(const Position& pos){
+    Bitboard attacked_sq = pawn_attacks<side>(pos.pieces(pawn | side));
+    Bitboard pieces;
+
+    for(pieces = pos.pieces(knight | side); pieces; pieces &= pieces - 1){
+        attacked_sq |= knight_attacks[get_lsb(pieces) - 1];
+    }
+    for(pieces = pos.pieces(king | side); pieces; pieces &= pieces - 1){
+        attacked_sq |= king_attacks[get_lsb(pieces) - 1];
+    }
+    for(pieces = pos.pieces(bishop | side) | pos.pieces(queen | side); pieces; pieces &= pieces - 1){
+        attacked_sq |= get_bishop_attack_BB(get_lsb(pieces) - 1, pos.occupied());
+    }
+    for(pieces = pos.pieces(rook | side) | pos.pieces(queen | side); pieces; pieces &= pieces - 1){
+        attacked_sq |= get_rook_attack_BB(get_lsb(pieces) - 1, pos.occupied());
+    }
+    return attacked_sq;
+}
+
+// Attacked squares with the slider fills done by the scalar fallback
+template <PieceColor side>
+Bitboard attacked_squares_scalar(const Position& pos){
+    Bitboard queens = pos.pieces(queen | side);
+
+    return knight_attack_map(pos.pieces(knight | side))
+           | king_attack_map(pos.pieces(king | side))
+           | slider_attack_map_scalar(pos.pieces(rook | side) | queens,
+                                      pos.pieces(bishop | side) | queens,
+                                      pos.free_squares())
+           | pawn_attacks<side>(pos.pieces(pawn | side));
+}
+
+// Times one way of computing the attacks of both sides over all bench positions
+template <typename AttackMap>
+void bench_attack_map(const std::string& name, const std::vector<Position>& positions, AttackMap attack_map){
+    constexpr int rounds = 200000;
+    Bitboard sink = 0;
+    int errors = 0;
+
+    for(const Position& pos : positions){
+        if(attack_map(pos) != (attacked_squares_by_lookup<white>(pos) ^ attacked_squares_by_lookup<black>(pos))) errors++;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int r = 0; r < rounds; r++){
+        for(const Position& pos : positions){
+            sink ^= attack_map(pos);
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    double time = std::chrono::duration<double, std::nano>(stop - start).count()/(2.0*rounds*positions.size());
+
+    std::cout << "  " << name << ": " << time << " ns/side, " << errors << " errors" << std::endl;
+
+    volatile Bitboard result = sink;
+    (void)result;
+}
+
+void bench_attack_maps(){
+    std::cout << "Attacked squares of one side" << std::endl;
+
+    // A vector of positions, each one is large because of the history
+    static std::vector<Position> positions(bench_fens.size());
+    for(size_t i = 0; i < bench_fens.size(); i++) read_from_fen(bench_fens[i], positions[i]);
+
+    bench_attack_map("Lookup per piece", positions, [](const Position& pos){
+        return attacked_squares_by_lookup<white>(pos) ^ attacked_squares_by_lookup<black>(pos);});
+    bench_attack_map("Fill, scalar    ", positions, [](const Position& pos){
+        return attacked_squares_scalar<white>(pos) ^ attacked_squares_scalar<black>(pos);});
+    // Vector fills if the build has AVX2 or AVX-512, else lookups for the sliders
+    bench_attack_map("attacked_squares", positions, [](const Position& pos){
+        return attacked_squares<white>(pos) ^ attacked_squares<black>(pos);});
+}
+
+// Attacks of every single slider of both sides, as the mobility eval needs them
+template <bool batched>
+double time_slider_batches(const std::vector<Position>& positions, Bitboard& sink){
+    constexpr int rounds = 200000;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int r = 0; r < rounds; r++){
+        for(const Position& pos : positions){
+            std::array<Square, 16> rook_squares, bishop_squares;
+            std::array<Bitboard, 16> rook_lines, bishop_lines;
+            int rooks = 0, bishops = 0;
+
+            Bitboard queens = pos.type_pieces(queen);
+            for(Bitboard bb = pos.type_pieces(rook) | queens; bb && (rooks < 16); bb &= bb - 1) rook_squares[rooks++] = get_lsb(bb) - 1;
+            for(Bitboard bb = pos.type_pieces(bishop) | queens; bb && (bishops < 16); bb &= bb - 1) bishop_squares[bishops++] = get_lsb(bb) - 1;
+
+            if constexpr(batched){
+#if defined(__AVX2__)
+                slider_attacks_batch_fill<true>(rook_squares.data(), rooks, pos.occupied(), rook_lines.data());
+                slider_attacks_batch_fill<false>(bishop_squares.data(), bishops, pos.occupied(), bishop_lines.data());
+#endif
+            }
+            else{
+                for(int i = 0; i < rooks; i++) rook_lines[i] = get_rook_attack_BB(rook_squares[i], pos.occupied());
+                for(int i = 0; i < bishops; i++) bishop_lines[i] = get_bishop_attack_BB(bishop_squares[i], pos.occupied());
+            }
+
+            for(int i = 0; i < rooks; i++) sink ^= rook_lines[i];
+            for(int i = 0; i < bishops; i++) sink += bishop_lines[i];
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::nano>(stop - start).count()/(1.0*rounds*positions.size());
+}
+
+void bench_slider_batches(){
+    static std::vector<Position> positions(bench_fens.size());
+    for(size_t i = 0; i < bench_fens.size(); i++) read_from_fen(bench_fens[i], positions[i]);
+    Bitboard sink = 0;
+
+    double lookups = time_slider_batches<false>(positions, sink);
+    std::cout << "Attacks of single sliders" << std::endl;
+    std::cout << "  lookup per slider: " << lookups << " ns/position" << std::endl;
+#if defined(__AVX2__)
+    double filled = time_slider_batches<true>(positions, sink);
+    std::cout << "  AVX2 lane fills:   " << filled << " ns/position" << std::endl;
+#endif
+
+    volatile Bitboard result = sink;
+    (void)result;
+}
+
+// Knowing if a move checks before making it, against making it and looking for checkers
+void bench_gives_check(){
+    constexpr int rounds = 20000;
+    static Position pos;
+    unsigned long long moves = 0, checks_predicted = 0, checks_made = 0;
+    double predicted_time = 0, made_time = 0;
+
+    std::cout << "Check detection per move" << std::endl;
+
+    for(const std::string& fen : bench_fens){
+        read_from_fen(fen, pos);
+        MoveList move_list;
+        generate_all(pos, &move_list);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for(int r = 0; r < rounds; r++){
+            AttackInfo attack_info(pos);
+            for(int i = 0; i < move_list.size; i++) checks_predicted += attack_info.gives_check(move_list.move_stack[i]);
+        }
+        auto mid = std::chrono::high_resolution_clock::now();
+        for(int r = 0; r < rounds; r++){
+            for(int i = 0; i < move_list.size; i++){
+                make_move(pos, move_list.move_stack[i]);
+                checks_made += get_checkers(pos.to_move, pos) != 0;
+                unmake_move(pos);
+            }
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+
+        predicted_time += std::chrono::duration<double, std::nano>(mid - start).count();
+        made_time += std::chrono::duration<double, std::nano>(stop - mid).count();
+        moves += 1ULL*rounds*move_list.size;
+    }
+
+    std::cout << "  gives_check:               " << predicted_time/moves << " ns/move" << std::endl;
+    std::cout << "  make, get_checkers, unmake: " << made_time/moves << " ns/move" << std::endl;
+    std::cout << "  Checks found: " << checks_predicted << " and " << checks_made << std::endl;
+}
+
+// Pawn structure evaluated from scratch, against a hit in the pawn table
+void bench_pawn_eval(){
+    constexpr int rounds = 1000000;
+    static std::vector<Position> positions(bench_fens.size());
+    for(size_t i = 0; i < bench_fens.size(); i++) read_from_fen(bench_fens[i], positions[i]);
+
+    int sink = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int r = 0; r < rounds; r++){
+        for(const Position& pos : positions){
+            int opening = 0, endgame = 0;
+            evaluate_pawns<white>(pos, opening, endgame);
+            evaluate_pawns<black>(pos, opening, endgame);
+            sink += opening + endgame;
+        }
+    }
+    auto mid = std::chrono::high_resolution_clock::now();
+    for(int r = 0; r < rounds; r++){
+        for(const Position& pos : positions){
+            const PawnEntry& entry = probe_pawn_table(pos);
+            sink += entry.opening + entry.endgame;
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+
+    double evaluated = std::chrono::duration<double, std::nano>(mid - start).count()/(1.0*rounds*positions.size());
+    double probed = std::chrono::duration<double, std::nano>(stop - mid).count()/(1.0*rounds*positions.size());
+
+    std::cout << "Pawn structure" << std::endl;
+    std::cout << "  evaluate_pawns:   " << evaluated << " ns/position" << std::endl;
+    std::cout << "  probe_pawn_table: " << probed << " ns/position" << std::endl;
+    print_footprint(sizeof(pawn_table));
+
+    volatile int result = sink;
+    (void)result;
+}
+
+// Full static eval, against a hit in the eval cache
+void bench_eval_cache(){
+    constexpr int rounds = 1000000;
+    static std::vector<Position> positions(bench_fens.size());
+    for(size_t i = 0; i < bench_fens.size(); i++) read_from_fen(bench_fens[i], positions[i]);
+
+    int sink = 0;
+    double evaluated = 0;
+
+    for(const Position& position : positions){
+        pos.copy_from(position);
+        bool exact = true;
+        store_eval_cache(pos.position_key, evaluate_position(-infinity_score, infinity_score, exact));
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for(int r = 0; r < rounds; r++) sink += evaluate_position(-infinity_score, infinity_score, exact);
+        auto stop = std::chrono::high_resolution_clock::now();
+        evaluated += std::chrono::duration<double, std::nano>(stop - start).count();
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int r = 0; r < rounds; r++){
+        for(const Position& position : positions){
+            int score = 0;
+            probe_eval_cache(position.position_key, score);
+            sink += score;
+        }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    double cached = std::chrono::duration<double, std::nano>(stop - start).count();
+
+    std::cout << "Static eval" << std::endl;
+    std::cout << "  evaluate_position: " << evaluated/(1.0*rounds*positions.size()) << " ns/position" << std::endl;
+    std::cout << "  probe_eval_cache:  " << cached/(1.0*rounds*positions.size()) << " ns/position" << std::endl;
+    print_footprint(sizeof(eval_cache));
+
+    volatile int result = sink;
+    (void)result;
+}
+
+#ifdef NNUE
+// Eval after each move with the accumulators updated from the parent, against computing them from scratch
+void bench_nnue(){
+    static Position pos;
+    unsigned long long moves = 0;
+    double incremental_time = 0, refresh_time = 0;
+    int sink = 0;
+
+    for(const std::string& fen : bench_fens){
+        read_from_fen(fen, pos);
+        MoveList move_list;
+        generate_all(pos, &move_list);
+        sink += nnue_evaluate(pos);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for(int r = 0; r < 2000; r++){
+            for(int i = 0; i < move_list.size; i++){
+                make_move(pos, move_list.move_stack[i]);
+                sink += nnue_evaluate(pos);
+                unmake_move(pos);
+            }
+        }
+        auto mid = std::chrono::high_resolution_clock::now();
+        for(int r = 0; r < 2000; r++){
+            for(int i = 0; i < move_list.size; i++){
+                make_move(pos, move_list.move_stack[i]);
+                refresh_accumulator(pos, 0, pos.history.accumulators[pos.history.size]);
+                refresh_accumulator(pos, 1, pos.history.accumulators[pos.history.size]);
+                sink += nnue_evaluate(pos);
+                unmake_move(pos);
+            }
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+
+        incremental_time += std::chrono::duration<double, std::nano>(mid - start).count();
+        refresh_time += std::chrono::duration<double, std::nano>(stop - mid).count();
+        moves += 2000ULL*move_list.size;
+    }
+
+#if defined(__AVX2__)
+    std::cout << "NNUE (AVX2)" << std::endl;
+#else
+    std::cout << "NNUE (scalar)" << std::endl;
+#endif
+    std::cout << "  make, update, eval, unmake:  " << incremental_time/moves << " ns/move" << std::endl;
+    std::cout << "  make, refresh, eval, unmake: " << refresh_time/moves << " ns/move" << std::endl;
+    print_footprint(sizeof(nnue_weights));
+
+    volatile int result = sink;
+    (void)result;
+}
+#endif
+
+void start_bench(){
+    bench_slider_attacks();
+    bench_attack_maps();
+    bench_slider_batches();
+    bench_gives_check();
+    bench_pawn_eval();
+    bench_eval_cache();
+#ifdef NNUE
+    bench_nnue();
+#endif
+}
+
+#endif // BENCH_H
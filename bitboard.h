@@ -7,10 +7,15 @@
 
 #include <array>
 #include <iostream>
+#include <initializer_list>
 
 #include "types.h"
 #include "utility.h"
 
+#if defined(SLIDER_PEXT) || defined(__AVX2__) || defined(__AVX512F__)
+    #include <immintrin.h>
+#endif
+
 /*
 This file contains the logic and tables to generate attack BBs for
 a piece on Square x 
@@ -295,7 +300,335 @@ constexpr Bitboard gen_bishop_attacks(Square sq, Bitboard occup_mask){
     return result;
 }
 
-// now generate actual Table
+static constexpr auto knight_attacks{[]() constexpr{
+    std::array<Bitboard, 64> result{};
+    short attacked_sq = 0;
+    Bitboard attack = 0ULL;
+    for (int sq = 0; sq < 64; sq++)
+    {
+        attacked_sq = 0;
+        attack = 0ULL;
+
+        for(auto offset : __N_DIR){
+            attacked_sq = (sq%8) +((sq/8) << 4) + offset; //translate to 0x88 and add direction
+            if(!(attacked_sq&0x88)){ // if it is on the board, add to attack BB
+                attack |= x88_to_bitboard(attacked_sq);
+            }
+        }
+        result[sq] = attack;
+    }
+    return result;
+}()};
+
+static constexpr auto king_attacks{[]() constexpr{
+    std::array<Bitboard, 64> result{};
+    short attacked_sq = 0;
+    Bitboard attack = 0ULL;
+    for (int sq = 0; sq < 64; sq++)
+    {
+        attacked_sq = 0;
+        attack = 0ULL;
+
+        for(auto offset : __K_DIR){
+            attacked_sq = (sq%8) +((sq/8) << 4) + offset; //translate to 0x88 and add direction
+            if(!(attacked_sq&0x88)){ // if it is on the board, add to attack BB
+                attack |= x88_to_bitboard(attacked_sq);
+            }
+        }
+        result[sq] = attack;
+    }
+    return result;
+}()};
+
+// The king's square and the squares around it, with the rank in front of those
+// towards the enemy. Indexed by the color of the king >> 3, then the square
+static constexpr auto king_zone{[]() constexpr{
+    std::array<std::array<Bitboard, 64>, 2> result{};
+    for(int sq = 0; sq < 64; sq++){
+        Bitboard around = king_attacks[sq] | (1ULL << sq);
+        result[0][sq] = around | (around << 8);
+        result[1][sq] = around | (around >> 8);
+    }
+    return result;
+}()};
+
+// Squares strictly between two squares on a common line, empty if there is none
+static constexpr auto squares_between{[]() constexpr{
+    std::array<std::array<Bitboard, 64>, 64> result{};
+
+    for (int a = 0; a < 64; a++){
+        for (int b = 0; b < 64; b++){
+            if(a == b) continue;
+            Bitboard from_a = 0ULL, from_b = 0ULL;
+
+            if(gen_rook_attacks(a, 0ULL) & (1ULL << b)){
+                from_a = gen_rook_attacks(a, 1ULL << b);
+                from_b = gen_rook_attacks(b, 1ULL << a);
+            }
+            else if(gen_bishop_attacks(a, 0ULL) & (1ULL << b)){
+                from_a = gen_bishop_attacks(a, 1ULL << b);
+                from_b = gen_bishop_attacks(b, 1ULL << a);
+            }
+            result[a][b] = from_a & from_b;
+        }
+    }
+    return result;
+}()};
+
+// PRE-GEN END
+
+
+// SLIDING PIECES:
+
+/*
+get_rook_attack_BB and get_bishop_attack_BB have several backends, one is
+picked at build time, e.g. make DEFINES=-DSLIDER_PEXT
+
+    default         fancy magic bitboards, the tables are generated at
+                    compile time (about 840 KB)
+    SLIDER_PEXT     same tables indexed with the BMI2 pext instruction,
+                    needs a CPU with BMI2 (checked at startup)
+    SLIDER_COMPACT  magic indexing into one byte per entry, which selects
+                    the attack board from a small pool of the distinct boards
+                    of that square, so entries with the same attacks are shared
+    SLIDER_HQ       computed with hyperbola quintessence, only a few KB of masks
+
+The bench command reports the speed and size of the selected backend.
+*/
+
+#if defined(SLIDER_PEXT) + defined(SLIDER_COMPACT) + defined(SLIDER_HQ) > 1
+    #error "Only one of SLIDER_PEXT, SLIDER_COMPACT and SLIDER_HQ can be selected"
+#endif
+
+#if defined(SLIDER_PEXT) && !defined(__BMI2__)
+    #error "SLIDER_PEXT needs BMI2, build with -mbmi2 or -march=native on a CPU that supports it"
+#endif
+
+#if defined(SLIDER_PEXT)
+
+constexpr const char* slider_backend_name = "pext";
+
+// With pext the index is just the blockers compressed to the mask bits, so
+// every square needs 2^(bits in mask) entries
+static constexpr auto rook_pext_offset{[]() constexpr{
+    std::array<unsigned int, 65> result{};
+    for (int i = 0; i < 64; i++){
+        result[i + 1] = result[i] + get_permutations(rook_mask[i]);
+    }
+    return result;
+}()};
+
+static constexpr auto bishop_pext_offset{[]() constexpr{
+    std::array<unsigned int, 65> result{};
+    for (int i = 0; i < 64; i++){
+        result[i + 1] = result[i] + get_permutations(bishop_mask[i]);
+    }
+    return result;
+}()};
+
+// num_to_mask places the bits of i on the mask, which is exactly what pext reverts
+static constexpr auto rook_attacks{[]() constexpr{
+    std::array<Bitboard, rook_pext_offset[64]> result{};
+
+    for (int sq = 0; sq < 64; sq++){
+        for(int i = 0; i < get_permutations(rook_mask[sq]); i++){
+            result[rook_pext_offset[sq] + i] = gen_rook_attacks(sq, num_to_mask(i, rook_mask[sq]));
+        }
+    }
+    return result;
+}()};
+
+static constexpr auto bishop_attacks{[]() constexpr{
+    std::array<Bitboard, bishop_pext_offset[64]> result{};
+
+    for (int sq = 0; sq < 64; sq++){
+        for(int i = 0; i < get_permutations(bishop_mask[sq]); i++){
+            result[bishop_pext_offset[sq] + i] = gen_bishop_attacks(sq, num_to_mask(i, bishop_mask[sq]));
+        }
+    }
+    return result;
+}()};
+
+constexpr size_t slider_footprint = sizeof(rook_attacks) + sizeof(bishop_attacks)
+                                    + sizeof(rook_pext_offset) + sizeof(bishop_pext_offset)
+                                    + sizeof(rook_mask) + sizeof(bishop_mask);
+
+inline Bitboard get_rook_attack_BB(Square sq, const Bitboard& blockers){
+    return rook_attacks[rook_pext_offset[sq] + _pext_u64(blockers, rook_mask[sq])];
+}
+
+inline Bitboard get_bishop_attack_BB(Square sq, const Bitboard& blockers){
+    return bishop_attacks[bishop_pext_offset[sq] + _pext_u64(blockers, bishop_mask[sq])];
+}
+
+#elif defined(SLIDER_COMPACT)
+
+constexpr const char* slider_backend_name = "compact magic";
+
+// A slider sees at most one blocker per direction, so the number of distinct
+// attack boards of a square is the product of the ray lengths (at most 144)
+constexpr int count_distinct_attacks(Square sq, std::initializer_list<short> directions){
+    int result = 1;
+    short x88_index = (sq%8) +((sq/8) << 4);
+
+    for(auto offset : directions){
+        int length = 0;
+        while(!((x88_index + offset*(length + 1))&0x88)) length++;
+        if(length) result *= length;
+    }
+    return result;
+}
+
+static constexpr auto rook_pool_offset{[]() constexpr{
+    std::array<unsigned int, 65> result{};
+    for (int i = 0; i < 64; i++){
+        result[i + 1] = result[i] + count_distinct_attacks(i, __R_DIR);
+    }
+    return result;
+}()};
+
+static constexpr auto bishop_pool_offset{[]() constexpr{
+    std::array<unsigned int, 65> result{};
+    for (int i = 0; i < 64; i++){
+        result[i + 1] = result[i] + count_distinct_attacks(i, __B_DIR);
+    }
+    return result;
+}()};
+
+struct CompactSliderTable{
+    // Index into the pool of the square, found with the usual magics
+    std::array<uint8_t, rook_table_offset[64]> rook_ids;
+    std::array<uint8_t, bishop_table_offset[64]> bishop_ids;
+
+    // Distinct attack boards, grouped by square
+    std::array<Bitboard, rook_pool_offset[64]> rook_pool;
+    std::array<Bitboard, bishop_pool_offset[64]> bishop_pool;
+};
+
+// Puts the attack board into the pool of the square if it is not there yet and returns its id
+inline uint8_t add_to_pool(Bitboard* pool, int& pool_size, Bitboard attacks){
+    for(int i = 0; i < pool_size; i++){
+        if(pool[i] == attacks) return i;
+    }
+    pool[pool_size] = attacks;
+    return pool_size++;
+}
+
+// Deduplicating is too slow for constexpr, so this is filled at startup
+static const auto compact_slider_table{[]() {
+    CompactSliderTable result{};
+
+    for (int sq = 0; sq < 64; sq++){
+        int pool_size = 0;
+        for(int i = 0; i < get_permutations(rook_mask[sq]); i++){
+            Bitboard mask = num_to_mask(i, rook_mask[sq]);
+            int index = (mask * rook_factor[sq]) >> rook_shift[sq];
+
+            result.rook_ids[rook_table_offset[sq] + index] =
+                add_to_pool(&result.rook_pool[rook_pool_offset[sq]], pool_size, gen_rook_attacks(sq, mask));
+        }
+
+        pool_size = 0;
+        for(int i = 0; i < get_permutations(bishop_mask[sq]); i++){
+            Bitboard mask = num_to_mask(i, bishop_mask[sq]);
+            int index = (mask * bishop_factor[sq]) >> bishop_shift[sq];
+
+            result.bishop_ids[bishop_table_offset[sq] + index] =
+                add_to_pool(&result.bishop_pool[bishop_pool_offset[sq]], pool_size, gen_bishop_attacks(sq, mask));
+        }
+    }
+    return result;
+}()};
+
+constexpr size_t slider_footprint = sizeof(CompactSliderTable)
+                                    + sizeof(rook_table_offset) + sizeof(bishop_table_offset)
+                                    + sizeof(rook_pool_offset) + sizeof(bishop_pool_offset)
+                                    + sizeof(rook_mask) + sizeof(bishop_mask)
+                                    + sizeof(rook_factor) + sizeof(bishop_factor)
+                                    + sizeof(rook_shift) + sizeof(bishop_shift);
+
+inline Bitboard get_rook_attack_BB(Square sq, const Bitboard& blockers){
+    return compact_slider_table.rook_pool[rook_pool_offset[sq] +
+        compact_slider_table.rook_ids[rook_table_offset[sq] +
+            (((blockers&rook_mask[sq])*rook_factor[sq]) >> rook_shift[sq])]];
+}
+
+inline Bitboard get_bishop_attack_BB(Square sq, const Bitboard& blockers){
+    return compact_slider_table.bishop_pool[bishop_pool_offset[sq] +
+        compact_slider_table.bishop_ids[bishop_table_offset[sq] +
+            (((blockers&bishop_mask[sq])*bishop_factor[sq]) >> bishop_shift[sq])]];
+}
+
+#elif defined(SLIDER_HQ)
+
+constexpr const char* slider_backend_name = "hyperbola quintessence";
+
+// Lines through a square without the square itself
+struct LineMasks{
+    Bitboard file;
+    Bitboard diagonal;
+    Bitboard anti_diagonal;
+};
+
+static constexpr auto hq_masks{[]() constexpr{
+    std::array<LineMasks, 64> result{};
+
+    for (int sq = 0; sq < 64; sq++){
+        for (int other = 0; other < 64; other++){
+            if(other == sq) continue;
+            if((other%8) == (sq%8)) result[sq].file |= 1ULL << other;
+            if((other/8 - other%8) == (sq/8 - sq%8)) result[sq].diagonal |= 1ULL << other;
+            if((other/8 + other%8) == (sq/8 + sq%8)) result[sq].anti_diagonal |= 1ULL << other;
+        }
+    }
+    return result;
+}()};
+
+// Attacks along the first rank for every file and the 6 inner squares as blockers
+static constexpr auto first_rank_attacks{[]() constexpr{
+    std::array<std::array<uint8_t, 64>, 8> result{};
+
+    for (int file = 0; file < 8; file++){
+        for (int inner = 0; inner < 64; inner++){
+            result[file][inner] = gen_rook_attacks(file, inner << 1) & __1_RANK;
+        }
+    }
+    return result;
+}()};
+
+// Byte swapping mirrors the board vertically, which reverses the order of the
+// squares on a file or diagonal, so o^(o-2r) works in both directions
+inline Bitboard hq_line_attacks(Square sq, Bitboard blockers, Bitboard line){
+    Bitboard forward = blockers & line;
+    Bitboard reverse = __builtin_bswap64(forward);
+
+    forward -= 1ULL << sq;
+    reverse -= 1ULL << (sq ^ 56);
+    forward ^= __builtin_bswap64(reverse);
+
+    return forward & line;
+}
+
+// Ranks can not be mirrored with a byte swap, so those come from a table
+inline Bitboard rank_attacks(Square sq, Bitboard blockers){
+    int rank_shift = sq & 56;
+    return Bitboard(first_rank_attacks[sq & 7][(blockers >> (rank_shift + 1)) & 63]) << rank_shift;
+}
+
+constexpr size_t slider_footprint = sizeof(hq_masks) + sizeof(first_rank_attacks);
+
+inline Bitboard get_rook_attack_BB(Square sq, const Bitboard& blockers){
+    return hq_line_attacks(sq, blockers, hq_masks[sq].file) | rank_attacks(sq, blockers);
+}
+
+inline Bitboard get_bishop_attack_BB(Square sq, const Bitboard& blockers){
+    return hq_line_attacks(sq, blockers, hq_masks[sq].diagonal)
+           | hq_line_attacks(sq, blockers, hq_masks[sq].anti_diagonal);
+}
+
+#else
+
+constexpr const char* slider_backend_name = "magic";
 
 static constexpr auto rook_attacks{[]() constexpr{
     constexpr int size = rook_table_offset[64];
@@ -347,55 +680,11 @@ static constexpr auto bishop_attacks{[]() constexpr{
     return result;
 }()};
 
-static constexpr auto knight_attacks{[]() constexpr{
-    std::array<Bitboard, 64> result{};
-    short attacked_sq = 0;
-    Bitboard attack = 0ULL;
-    for (int sq = 0; sq < 64; sq++)
-    {
-        attacked_sq = 0;
-        attack = 0ULL;
-
-        for(auto offset : __N_DIR){
-            attacked_sq = (sq%8) +((sq/8) << 4) + offset; //translate to 0x88 and add direction
-            if(!(attacked_sq&0x88)){ // if it is on the board, add to attack BB
-                attack |= x88_to_bitboard(attacked_sq);
-            }
-        }
-        result[sq] = attack;
-    }
-    return result;
-}()};
-
-static constexpr auto king_attacks{[]() constexpr{
-    std::array<Bitboard, 64> result{};
-    short attacked_sq = 0;
-    Bitboard attack = 0ULL;
-    for (int sq = 0; sq < 64; sq++)
-    {
-        attacked_sq = 0;
-        attack = 0ULL;
-
-        for(auto offset : __K_DIR){
-            attacked_sq = (sq%8) +((sq/8) << 4) + offset; //translate to 0x88 and add direction
-            if(!(attacked_sq&0x88)){ // if it is on the board, add to attack BB
-                attack |= x88_to_bitboard(attacked_sq);
-            }
-        }
-        result[sq] = attack;
-    }
-    return result;
-}()};
-
-// PRE-GEN END
-
-
-
-
-
-
-
-
+constexpr size_t slider_footprint = sizeof(rook_attacks) + sizeof(bishop_attacks)
+                                    + sizeof(rook_table_offset) + sizeof(bishop_table_offset)
+                                    + sizeof(rook_mask) + sizeof(bishop_mask)
+                                    + sizeof(rook_factor) + sizeof(bishop_factor)
+                                    + sizeof(rook_shift) + sizeof(bishop_shift);
 
 // Getter functions for rook and bishop attacks.
 
@@ -413,6 +702,18 @@ inline Bitboard get_bishop_attack_BB(Square sq, const Bitboard& blockers){
         (((blockers&bishop_mask[sq])*bishop_factor[sq]) >> bishop_shift[sq])];
 }
 
+#endif
+
+// The pext build crashes on CPUs without BMI2, so main checks this first
+inline bool slider_backend_supported(){
+#ifdef SLIDER_PEXT
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2");
+#else
+    return true;
+#endif
+}
+
 // Pawn moves via shifts
 
 // White
@@ -448,6 +749,238 @@ inline Bitboard pawn_south_east(const Bitboard& pawns){
     return (pawns&(~__H_FILE)) >> 7;
 }
 
+// Both colors, resolved at compile time. West and east are seen from white,
+// so the west attack of a black pawn is the south west one
+
+template <PieceColor side>
+inline Bitboard pawn_push(const Bitboard& pawns){
+    if constexpr (side == white) return pawn_push_north(pawns);
+    else return pawn_push_south(pawns);
+}
+
+template <PieceColor side>
+inline Bitboard pawn_west(const Bitboard& pawns){
+    if constexpr (side == white) return pawn_north_west(pawns);
+    else return pawn_south_west(pawns);
+}
+
+template <PieceColor side>
+inline Bitboard pawn_east(const Bitboard& pawns){
+    if constexpr (side == white) return pawn_north_east(pawns);
+    else return pawn_south_east(pawns);
+}
+
+template <PieceColor side>
+inline Bitboard pawn_attacks(const Bitboard& pawns){
+    return pawn_west<side>(pawns) | pawn_east<side>(pawns);
+}
+
+// Offsets from the target square back to the origin of a pawn move
+template <PieceColor side> constexpr int pawn_push_offset = (side == white) ? 8 : -8;
+template <PieceColor side> constexpr int pawn_west_offset = (side == white) ? 7 : -9;
+template <PieceColor side> constexpr int pawn_east_offset = (side == white) ? 9 : -7;
+
+// Rank masks relative to the side to move
+template <PieceColor side> constexpr Bitboard pawn_double_rank     = (side == white) ? __3_RANK : __6_RANK;
+template <PieceColor side> constexpr Bitboard pawn_promotion_rank  = (side == white) ? __7_RANK : __2_RANK;
+template <PieceColor side> constexpr Bitboard pawn_non_promoting   = (side == white) ? non_promoting_w : non_promoting_b;
+
+
+// SET-WISE ATTACKS:
+// Attacks of all pieces on a board at once, without looping over the pieces
+
+inline Bitboard knight_attack_map(const Bitboard& knights){
+    Bitboard west_1 = (knights >> 1) & ~__H_FILE;
+    Bitboard west_2 = (knights >> 2) & ~(__G_FILE | __H_FILE);
+    Bitboard east_1 = (knights << 1) & ~__A_FILE;
+    Bitboard east_2 = (knights << 2) & ~(__A_FILE | __B_FILE);
+
+    Bitboard one_file = west_1 | east_1;
+    Bitboard two_files = west_2 | east_2;
+
+    return (one_file << 16) | (one_file >> 16) | (two_files << 8) | (two_files >> 8);
+}
+
+inline Bitboard king_attack_map(const Bitboard& kings){
+    Bitboard attacks = ((kings << 1) & ~__A_FILE) | ((kings >> 1) & ~__H_FILE);
+    Bitboard row = attacks | kings;
 
+    return attacks | (row << 8) | (row >> 8);
+}
+
+/*
+Sliding attacks of all sliders with Kogge-Stone occluded fills. Every
+direction is a fill of the sliders through the empty squares in three
+shift steps, followed by one more step for the attacked blocker.
+
+The first four directions shift left, the other four right. Rooks use
+N, E, S, W and bishops the diagonals. With AVX-512 all eight directions
+are one vector (right shifts become rotates, the masks clear what wraps
+around), with AVX2 the left and right directions are one vector each.
+Otherwise it is the plain loop over the directions below.
+*/
+
+// Directions in order: N, E, NE, NW, S, W, SW, SE
+static constexpr std::array<int, 8> fill_shift = {8,  1,  9,  7,  8,  1,  9,  7};
+
+static constexpr std::array<Bitboard, 8> fill_mask = {
+    ~__1_RANK,
+    ~__A_FILE,
+    ~(__A_FILE | __1_RANK),
+    ~(__H_FILE | __1_RANK),
+    ~__8_RANK,
+    ~__H_FILE,
+    ~(__H_FILE | __8_RANK),
+    ~(__A_FILE | __8_RANK)
+};
+
+// Attacks of the sliders in one direction, the shifts are known at compile time
+template <int dir>
+inline Bitboard occluded_fill_attacks(Bitboard gen, Bitboard empty){
+    constexpr int s = fill_shift[dir];
+    constexpr Bitboard mask = fill_mask[dir];
+    auto step = [](Bitboard bb, int amount){return (dir < 4) ? (bb << amount) : (bb >> amount);};
+
+    Bitboard pro = empty & mask;
+
+    gen |= pro & step(gen, s);
+    pro &= step(pro, s);
+    gen |= pro & step(gen, 2*s);
+    pro &= step(pro, 2*s);
+    gen |= pro & step(gen, 4*s);
+
+    return step(gen, s) & mask;
+}
+
+inline Bitboard slider_attack_map_scalar(Bitboard rook_sliders, Bitboard bishop_sliders, Bitboard empty){
+    return occluded_fill_attacks<0>(rook_sliders, empty)
+           | occluded_fill_attacks<1>(rook_sliders, empty)
+           | occluded_fill_attacks<2>(bishop_sliders, empty)
+           | occluded_fill_attacks<3>(bishop_sliders, empty)
+           | occluded_fill_attacks<4>(rook_sliders, empty)
+           | occluded_fill_attacks<5>(rook_sliders, empty)
+           | occluded_fill_attacks<6>(bishop_sliders, empty)
+           | occluded_fill_attacks<7>(bishop_sliders, empty);
+}
+
+inline Bitboard slider_attack_map(Bitboard rook_sliders, Bitboard bishop_sliders, Bitboard empty){
+#if defined(__AVX512F__)
+    const __m512i shift = _mm512_setr_epi64(8, 1, 9, 7, 64 - 8, 64 - 1, 64 - 9, 64 - 7);
+    const __m512i mask = _mm512_loadu_si512(fill_mask.data());
+
+    __m512i gen = _mm512_mask_blend_epi64(0b11001100, _mm512_set1_epi64(rook_sliders), _mm512_set1_epi64(bishop_sliders));
+    __m512i pro = _mm512_and_si512(_mm512_set1_epi64(empty), mask);
+
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_rolv_epi64(gen, shift)));
+    pro = _mm512_and_si512(pro, _mm512_rolv_epi64(pro, shift));
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_rolv_epi64(gen, _mm512_slli_epi64(shift, 1))));
+    pro = _mm512_and_si512(pro, _mm512_rolv_epi64(pro, _mm512_slli_epi64(shift, 1)));
+    gen = _mm512_or_si512(gen, _mm512_and_si512(pro, _mm512_rolv_epi64(gen, _mm512_slli_epi64(shift, 2))));
+
+    return _mm512_reduce_or_epi64(_mm512_and_si512(_mm512_rolv_epi64(gen, shift), mask));
+#elif defined(__AVX2__)
+    const __m256i shift = _mm256_setr_epi64x(8, 1, 9, 7);
+    const __m256i shift_2 = _mm256_slli_epi64(shift, 1);
+    const __m256i shift_4 = _mm256_slli_epi64(shift, 2);
+    const __m256i mask_left = _mm256_loadu_si256((const __m256i*)fill_mask.data());
+    const __m256i mask_right = _mm256_loadu_si256((const __m256i*)(fill_mask.data() + 4));
+
+    __m256i gen_left = _mm256_setr_epi64x(rook_sliders, rook_sliders, bishop_sliders, bishop_sliders);
+    __m256i gen_right = gen_left;
+    __m256i pro_left = _mm256_and_si256(_mm256_set1_epi64x(empty), mask_left);
+    __m256i pro_right = _mm256_and_si256(_mm256_set1_epi64x(empty), mask_right);
+
+    gen_left  = _mm256_or_si256(gen_left,  _mm256_and_si256(pro_left,  _mm256_sllv_epi64(gen_left,  shift)));
+    gen_right = _mm256_or_si256(gen_right, _mm256_and_si256(pro_right, _mm256_srlv_epi64(gen_right, shift)));
+    pro_left  = _mm256_and_si256(pro_left,  _mm256_sllv_epi64(pro_left,  shift));
+    pro_right = _mm256_and_si256(pro_right, _mm256_srlv_epi64(pro_right, shift));
+
+    gen_left  = _mm256_or_si256(gen_left,  _mm256_and_si256(pro_left,  _mm256_sllv_epi64(gen_left,  shift_2)));
+    gen_right = _mm256_or_si256(gen_right, _mm256_and_si256(pro_right, _mm256_srlv_epi64(gen_right, shift_2)));
+    pro_left  = _mm256_and_si256(pro_left,  _mm256_sllv_epi64(pro_left,  shift_2));
+    pro_right = _mm256_and_si256(pro_right, _mm256_srlv_epi64(pro_right, shift_2));
+
+    gen_left  = _mm256_or_si256(gen_left,  _mm256_and_si256(pro_left,  _mm256_sllv_epi64(gen_left,  shift_4)));
+    gen_right = _mm256_or_si256(gen_right, _mm256_and_si256(pro_right, _mm256_srlv_epi64(gen_right, shift_4)));
+
+    __m256i attacks = _mm256_or_si256(_mm256_and_si256(_mm256_sllv_epi64(gen_left, shift), mask_left),
+                                      _mm256_and_si256(_mm256_srlv_epi64(gen_right, shift), mask_right));
+
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(attacks), _mm256_extracti128_si256(attacks, 1));
+    return _mm_cvtsi128_si64(half) | _mm_extract_epi64(half, 1);
+#else
+    return slider_attack_map_scalar(rook_sliders, bishop_sliders, empty);
+#endif
+}
+
+/*
+Attacks of single sliders in batches, for the eval which needs the attacks
+of each piece and not only their union. By default every slider is looked
+up, with make DEFINES=-DBATCH_FILL and AVX2 every lane of a vector holds
+one slider and the lanes are filled one direction after the other with
+the fill above. Four sliders cost as much as one there, but the eight
+fill steps for four directions still take longer than four lookups (bench:
+55-70 ns against 20-38 ns for all sliders of a position), so it is off.
+*/
+#if defined(BATCH_FILL) && !defined(__AVX2__)
+#error "BATCH_FILL needs AVX2"
+#endif
+
+#if defined(__AVX2__)
+template <int dir>
+inline __m256i occluded_fill_attacks_x4(__m256i gen, __m256i empty){
+    constexpr int s = fill_shift[dir];
+    const __m256i mask = _mm256_set1_epi64x(fill_mask[dir]);
+    auto step = [](__m256i bb, int amount){
+        return (dir < 4) ? _mm256_slli_epi64(bb, amount) : _mm256_srli_epi64(bb, amount);
+    };
+
+    __m256i pro = _mm256_and_si256(empty, mask);
+
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, step(gen, s)));
+    pro = _mm256_and_si256(pro, step(pro, s));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, step(gen, 2*s)));
+    pro = _mm256_and_si256(pro, step(pro, 2*s));
+    gen = _mm256_or_si256(gen, _mm256_and_si256(pro, step(gen, 4*s)));
+
+    return _mm256_and_si256(step(gen, s), mask);
+}
+
+// Writes the attacks of the sliders on squares[0..count) to attacks, rook or bishop lines
+template <bool rook_lines>
+inline void slider_attacks_batch_fill(const Square* squares, int count, Bitboard occupied, Bitboard* attacks){
+    const __m256i empty = _mm256_set1_epi64x(~occupied);
+
+    for(int i = 0; i < count; i += 4){
+        alignas(32) std::array<Bitboard, 4> sliders{};
+        for(int lane = 0; (lane < 4) && (i + lane < count); lane++) sliders[lane] = 1ULL << squares[i + lane];
+
+        __m256i gen = _mm256_load_si256((const __m256i*)sliders.data());
+        __m256i result;
+        if constexpr(rook_lines){
+            result = _mm256_or_si256(_mm256_or_si256(occluded_fill_attacks_x4<0>(gen, empty), occluded_fill_attacks_x4<1>(gen, empty)),
+                                     _mm256_or_si256(occluded_fill_attacks_x4<4>(gen, empty), occluded_fill_attacks_x4<5>(gen, empty)));
+        }
+        else{
+            result = _mm256_or_si256(_mm256_or_si256(occluded_fill_attacks_x4<2>(gen, empty), occluded_fill_attacks_x4<3>(gen, empty)),
+                                     _mm256_or_si256(occluded_fill_attacks_x4<6>(gen, empty), occluded_fill_attacks_x4<7>(gen, empty)));
+        }
+        _mm256_store_si256((__m256i*)sliders.data(), result);
+
+        for(int lane = 0; (lane < 4) && (i + lane < count); lane++) attacks[i + lane] = sliders[lane];
+    }
+}
+#endif
+
+template <bool rook_lines>
+inline void slider_attacks_batch(const Square* squares, int count, Bitboard occupied, Bitboard* attacks){
+#if defined(BATCH_FILL)
+    slider_attacks_batch_fill<rook_lines>(squares, count, occupied, attacks);
+#else
+    for(int i = 0; i < count; i++){
+        attacks[i] = rook_lines ? get_rook_attack_BB(squares[i], occupied) : get_bishop_attack_BB(squares[i], occupied);
+    }
+#endif
+}
 
 #endif //ATTACKS
\ No newline at end of file
@@ -45,18 +45,18 @@ void print_position(const Position& pos){
 
             mask = 1;
             mask = mask << (i + (j*8));
-            if(pos.piece_bitboards[b_pawn]&mask)        {std::cout << "♙ ";}
-            else if( pos.piece_bitboards[b_knight]&mask){std::cout << "♘ ";}
-            else if( pos.piece_bitboards[b_king]&mask)  {std::cout << "♔ ";}
-            else if( pos.piece_bitboards[b_bishop]&mask){std::cout << "♗ ";}
-            else if( pos.piece_bitboards[b_rook]&mask)  {std::cout << "♖ ";}
-            else if( pos.piece_bitboards[b_queen]&mask) {std::cout << "♕ ";}
-            else if( pos.piece_bitboards[w_pawn]&mask)  {std::cout << "♟ ";}
-            else if( pos.piece_bitboards[w_knight]&mask){std::cout << "♞ ";}
-            else if( pos.piece_bitboards[w_king]&mask)  {std::cout << "♚ ";}
-            else if( pos.piece_bitboards[w_bishop]&mask){std::cout << "♝ ";}
-            else if( pos.piece_bitboards[w_rook]&mask)  {std::cout << "♜ ";}
-            else if( pos.piece_bitboards[w_queen]&mask) {std::cout << "♛ ";}
+            if(pos.pieces(b_pawn)&mask)        {std::cout << "♙ ";}
+            else if( pos.pieces(b_knight)&mask){std::cout << "♘ ";}
+            else if( pos.pieces(b_king)&mask)  {std::cout << "♔ ";}
+            else if( pos.pieces(b_bishop)&mask){std::cout << "♗ ";}
+            else if( pos.pieces(b_rook)&mask)  {std::cout << "♖ ";}
+            else if( pos.pieces(b_queen)&mask) {std::cout << "♕ ";}
+            else if( pos.pieces(w_pawn)&mask)  {std::cout << "♟ ";}
+            else if( pos.pieces(w_knight)&mask){std::cout << "♞ ";}
+            else if( pos.pieces(w_king)&mask)  {std::cout << "♚ ";}
+            else if( pos.pieces(w_bishop)&mask){std::cout << "♝ ";}
+            else if( pos.pieces(w_rook)&mask)  {std::cout << "♜ ";}
+            else if( pos.pieces(w_queen)&mask) {std::cout << "♛ ";}
             else if(((i%2) + (j%2))%2){std::cout << "██";}
             else {std::cout << "  ";}
             
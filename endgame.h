@@ -0,0 +1,230 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+#include "types.h"
+#include "utility.h"
+#include "bitboard.h"
+#include "position.h"
+#include "position_tables.h"
+
+/*
+Evaluation of endgames the normal eval does not understand. The material
+table picks one of these by the pieces on the board, see material.h.
+
+    KPK     exact, from a bitbase that is generated at startup
+    KBNK    drives the lone king to a corner of the bishop's color
+    KXK     a lone king against a rook or queen and anything else (KRK,
+            KQK, ...), drives the king to the edge and the kings together
+
+All of them return the score from white's point of view in centipawns.
+*/
+
+// Known wins are far above any normal eval and far below the mate scores
+constexpr int known_win_score = 10000;
+
+inline int square_distance(Square a, Square b){
+    return std::max(std::abs(a%8 - b%8), std::abs(a/8 - b/8));
+}
+
+// 0 on the four center squares up to 6 in the corners
+inline int center_distance(Square sq){
+    int file = sq%8, rank = sq/8;
+    return std::max(3 - file, file - 4) + std::max(3 - rank, rank - 4);
+}
+
+// KPK BITBASE:
+
+/*
+All positions with the pawn on files a-d and white to have the pawn, the
+others are mirrored to these. Index: side to move, then the black king,
+the white king and the pawn (file + 4*(rank - 1), ranks 2-7).
+
+The results are found backwards from the positions that are decided right
+away (the pawn promotes safely, black is stalemated or takes the pawn):
+white wins if one move leads to a win, black draws if one move leads to a
+draw. Positions that are still unknown when nothing changes anymore are draws.
+*/
+constexpr int kpk_size = 2*64*64*24;
+
+inline int kpk_index(bool black_to_move, Square black_king, Square white_king, Square pawn_sq){
+    return black_to_move + 2*(black_king + 64*(white_king + 64*((pawn_sq%8) + 4*(pawn_sq/8 - 1))));
+}
+
+enum KpkResult : uint8_t{
+    kpk_invalid = 0,
+    kpk_unknown = 1,
+    kpk_draw    = 2,
+    kpk_win     = 4
+};
+
+inline KpkResult kpk_initial_result(bool black_to_move, Square black_king, Square white_king, Square pawn_sq){
+    Bitboard pawn_bb = 1ULL << pawn_sq;
+    Bitboard pawn_att = pawn_attacks<white>(pawn_bb);
+    Square promotion_sq = pawn_sq + 8;
+
+    if((square_distance(white_king, black_king) <= 1) || (white_king == pawn_sq) || (black_king == pawn_sq)
+       || (!black_to_move && (pawn_att & (1ULL << black_king)))){
+        return kpk_invalid;
+    }
+
+    // The pawn promotes and the queen can not be taken
+    if(!black_to_move && (pawn_sq/8 == 6)
+       && (white_king != promotion_sq) && (black_king != promotion_sq)
+       && ((square_distance(black_king, promotion_sq) > 1) || (square_distance(white_king, promotion_sq) == 1))){
+        return kpk_win;
+    }
+
+    // Stalemate or the pawn can be taken
+    if(black_to_move){
+        Bitboard escapes = king_attacks[black_king] & ~(king_attacks[white_king] | pawn_att);
+        if(!escapes || (escapes & pawn_bb)) return kpk_draw;
+    }
+
+    return kpk_unknown;
+}
+
+inline KpkResult kpk_next_result(const std::vector<uint8_t>& results, bool black_to_move,
+                                 Square black_king, Square white_king, Square pawn_sq){
+    uint8_t found = 0;
+
+    if(black_to_move){
+        for(Bitboard to = king_attacks[black_king]; to; to &= to - 1){
+            found |= results[kpk_index(false, get_lsb(to) - 1, white_king, pawn_sq)];
+        }
+        if(found & kpk_draw) return kpk_draw;
+        if(found & kpk_unknown) return kpk_unknown;
+        return kpk_win;
+    }
+
+    for(Bitboard to = king_attacks[white_king] & ~(1ULL << pawn_sq); to; to &= to - 1){
+        found |= results[kpk_index(true, black_king, get_lsb(to) - 1, pawn_sq)];
+    }
+
+    // Pushes to the last rank are decided by kpk_initial_result
+    Square push_sq = pawn_sq + 8;
+    if((pawn_sq/8 < 6) && (push_sq != white_king) && (push_sq != black_king)){
+        found |= results[kpk_index(true, black_king, white_king, push_sq)];
+
+        Square double_sq = push_sq + 8;
+        if((pawn_sq/8 == 1) && (double_sq != white_king) && (double_sq != black_king)){
+            found |= results[kpk_index(true, black_king, white_king, double_sq)];
+        }
+    }
+
+    if(found & kpk_win) return kpk_win;
+    if(found & kpk_unknown) return kpk_unknown;
+    return kpk_draw;
+}
+
+// One bit per position, set if white wins
+static const auto kpk_bitbase{[]() {
+    std::vector<uint8_t> results(kpk_size);
+
+    auto for_each_position = [](auto visit){
+        for(Square pawn_sq = 8; pawn_sq < 56; pawn_sq++){
+            if(pawn_sq%8 > 3) continue;
+            for(Square white_king = 0; white_king < 64; white_king++){
+                for(Square black_king = 0; black_king < 64; black_king++){
+                    visit(false, black_king, white_king, pawn_sq);
+                    visit(true, black_king, white_king, pawn_sq);
+                }
+            }
+        }
+    };
+
+    for_each_position([&](bool black_to_move, Square black_king, Square white_king, Square pawn_sq){
+        results[kpk_index(black_to_move, black_king, white_king, pawn_sq)] =
+            kpk_initial_result(black_to_move, black_king, white_king, pawn_sq);
+    });
+
+    bool changed = true;
+    while(changed){
+        changed = false;
+        for_each_position([&](bool black_to_move, Square black_king, Square white_king, Square pawn_sq){
+            uint8_t& result = results[kpk_index(black_to_move, black_king, white_king, pawn_sq)];
+            if(result != kpk_unknown) return;
+
+            result = kpk_next_result(results, black_to_move, black_king, white_king, pawn_sq);
+            if(result != kpk_unknown) changed = true;
+        });
+    }
+
+    std::array<uint64_t, kpk_size/64> result{};
+    for(int i = 0; i < kpk_size; i++){
+        if(results[i] == kpk_win) result[i/64] |= 1ULL << (i%64);
+    }
+    return result;
+}()};
+
+inline bool kpk_probe(bool black_to_move, Square black_king, Square white_king, Square pawn_sq){
+    int index = kpk_index(black_to_move, black_king, white_king, pawn_sq);
+    return kpk_bitbase[index/64] & (1ULL << (index%64));
+}
+
+// EVALUATORS:
+
+template <PieceColor strong>
+int evaluate_kpk(const Position& pos){
+    constexpr PieceColor weak = opponent<strong>;
+
+    Square strong_king = get_lsb(pos.pieces(king | strong)) - 1;
+    Square weak_king = get_lsb(pos.pieces(king | weak)) - 1;
+    Square pawn_sq = get_lsb(pos.pieces(pawn | strong)) - 1;
+
+    // Seen from the side with the pawn, with the pawn on files a-d
+    if constexpr(strong == black){
+        strong_king ^= 56;
+        weak_king ^= 56;
+        pawn_sq ^= 56;
+    }
+    if(pawn_sq%8 > 3){
+        strong_king ^= 7;
+        weak_king ^= 7;
+        pawn_sq ^= 7;
+    }
+
+    if(!kpk_probe(pos.to_move == weak, weak_king, strong_king, pawn_sq)) return draw_score;
+
+    int score = known_win_score + 20*(pawn_sq/8);
+    return (strong == white) ? score : -score;
+}
+
+template <PieceColor strong>
+int evaluate_kbnk(const Position& pos){
+    constexpr PieceColor weak = opponent<strong>;
+
+    Square strong_king = get_lsb(pos.pieces(king | strong)) - 1;
+    Square weak_king = get_lsb(pos.pieces(king | weak)) - 1;
+    Square bishop_sq = get_lsb(pos.pieces(bishop | strong)) - 1;
+
+    // Only the corners of the bishop's color can be mated in, a1 is dark
+    bool dark_bishop = ((bishop_sq/8 + bishop_sq%8)%2) == 0;
+    int corner = dark_bishop ? std::min(square_distance(weak_king, A1), square_distance(weak_king, H8))
+                             : std::min(square_distance(weak_king, A8), square_distance(weak_king, H1));
+
+    int score = known_win_score + 600 - 40*corner - 10*square_distance(strong_king, weak_king);
+    return (strong == white) ? score : -score;
+}
+
+template <PieceColor strong>
+int evaluate_kxk(const Position& pos){
+    constexpr PieceColor weak = opponent<strong>;
+
+    Square strong_king = get_lsb(pos.pieces(king | strong)) - 1;
+    Square weak_king = get_lsb(pos.pieces(king | weak)) - 1;
+
+    int material = 0;
+    for(PieceType p_type : {pawn, knight, bishop, rook, queen}){
+        material += 100*material_value[p_type]*count_bits(pos.pieces(p_type | strong));
+    }
+
+    int score = known_win_score + material + 20*center_distance(weak_king) - 10*square_distance(strong_king, weak_king);
+    return (strong == white) ? score : -score;
+}
+
+#endif // ENDGAME_H
@@ -4,17 +4,30 @@
 #include "perft.h"
 #include "play.h"
 #include "test.h"
+#include "bench.h"
 
 int main(){
     
+    if(!slider_backend_supported()){
+        std::cout << "This build uses " << slider_backend_name << " attacks, which this CPU does not support" << std::endl;
+        return 1;
+    }
+
+#ifdef NNUE
+    nnue_loaded = load_nnue(nnue_file);
+    if(!nnue_loaded) std::cout << "NNUE: no network in " << nnue_file << ", using the normal eval" << std::endl;
+#endif
+
     std::string command;
-    std::cout << "Type command (play, test, perft, divide): " << std::endl;
+    std::cout << "Type command (play, analyse, test, perft, divide, bench): " << std::endl;
     std::getline(std::cin, command);
     
     if(command == "perft") start_perft();
     if(command == "divide") start_divide();
     else if (command == "play") start_game();
+    else if (command == "analyse") start_analysis();
     else if (command == "test") start_test();
+    else if (command == "bench") start_bench();
 
     return 0; 
 }
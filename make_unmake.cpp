@@ -6,6 +6,16 @@
 #include "types.h"
 #include "position.h"
 #include "bitboard.h"
+#include "position_tables.h"
+
+/*
+make_move and unmake_move dispatch once on the side to move, the actual
+work is done by the templates below which are specialized on the color.
+Inside, the move kind (flags 0xF000) selects the special handling.
+
+Build with -DCOPY_MAKE to save a copy of the BoardState in make_move and
+restore it in unmake_move instead of reverting the move incrementally.
+*/
 
 //Helper for castling rights
 
@@ -20,346 +30,271 @@ static constexpr std::array<uint8_t, 64> cstl_array = {
     0b0111, 0b1111, 0b1111, 0b1111, 0b0011, 0b1111, 0b1111, 0b1011
 };
 
+// Rook move that belongs to a castling move, indexed by the target square of the king
+static constexpr auto cstl_rook_from{[]() constexpr{
+    std::array<Square, 64> result{};
+    result[G1] = H1;
+    result[C1] = A1;
+    result[G8] = H8;
+    result[C8] = A8;
+    return result;
+}()};
+
+static constexpr auto cstl_rook_to{[]() constexpr{
+    std::array<Square, 64> result{};
+    result[G1] = F1;
+    result[C1] = D1;
+    result[G8] = F8;
+    result[C8] = D8;
+    return result;
+}()};
+
+// Both rook squares in one board, so the rook can be moved with a single xor
+static constexpr auto cstl_rook_delta{[]() constexpr{
+    std::array<Bitboard, 64> result{};
+    for(Square sq : {G1, C1, G8, C8}){
+        result[sq] = (1ULL << cstl_rook_from[sq]) | (1ULL << cstl_rook_to[sq]);
+    }
+    return result;
+}()};
+
+// Key difference for every change of the castling rights (old ^ new)
+static const auto cstl_key_delta{[]() {
+    std::array<uint64_t, 16> result{};
+    for(int rights = 0; rights < 16; rights++){
+        for(int i = 0; i < 4; i++){
+            if(rights & (1 << i)) result[rights] ^= rnd_value_array[cstl_K_rnd_id + i];
+        }
+    }
+    return result;
+}()};
+
+
+// Adds (sign 1) or removes (sign -1) a piece in the piece square sums, nothing for an empty square
+template <int sign>
+inline void update_psqt(Position& pos, Piece pce, Square sq){
+    int color_sign = (pce&black) ? -sign : sign;
+    pos.psqt_opening += color_sign*piece_square_tbl_opening[64*pce + sq];
+    pos.psqt_endgame += color_sign*piece_square_tbl_endgame[64*pce + sq];
+}
+
+template <PieceColor side>
+inline void make_castling(Position& pos, Square to){
+    constexpr Piece rook_pce = rook | side;
+    Square rook_from = cstl_rook_from[to];
+    Square rook_to = cstl_rook_to[to];
+
+    pos.board[rook_from] = no_piece;
+    pos.board[rook_to] = rook_pce;
+
+    pos.type_bitboards[rook - 1] ^= cstl_rook_delta[to];
+    pos.color_bitboards[side >> 3] ^= cstl_rook_delta[to];
+
+    pos.position_key ^= rnd_value_array[64*rook_pce + rook_from]
+                        ^ rnd_value_array[64*rook_pce + rook_to];
+
+    update_psqt<-1>(pos, rook_pce, rook_from);
+    update_psqt<1>(pos, rook_pce, rook_to);
+}
+
+template <PieceColor side>
+inline void unmake_castling(Position& pos, Square to){
+    constexpr Piece rook_pce = rook | side;
 
+    pos.board[cstl_rook_to[to]] = no_piece;
+    pos.board[cstl_rook_from[to]] = rook_pce;
+
+    update_psqt<-1>(pos, rook_pce, cstl_rook_to[to]);
+    update_psqt<1>(pos, rook_pce, cstl_rook_from[to]);
+
+    pos.type_bitboards[rook - 1] ^= cstl_rook_delta[to];
+    pos.color_bitboards[side >> 3] ^= cstl_rook_delta[to];
+}
+
+// Removes or puts back the pawn that is captured en passant
+template <PieceColor side>
+inline void toggle_en_passant_victim(Position& pos, Square to){
+    constexpr Piece victim = pawn | opponent<side>;
+    Square sq = to - pawn_push_offset<side>;
+
+    remove_piece(pos, sq, victim);
+}
+
+template <PieceColor side>
 bool make_move(Position& pos, Move move){
-    Square from = move&0b111111;
-    Square to = (move >> 6)&0b111111;
+    Square from = from_square(move);
+    Square to = to_square(move);
 
     // Target and moved pieces are saved here
     Piece target = pos.board[to];
     Piece moved = pos.board[from];
 
-    /*
-    UndoObject undo = UndoObject(moved, target, move, 
-                                pos.en_passant, 
-                                pos.castling_rights,
-                                pos.halfmove_clock, 
-                                pos.position_key);
-    */
+    uint8_t old_rights = pos.castling_rights;
+
+#ifdef ATTACK_COUNTS
+    // Squares that change their occupancy, all pieces on them and all sliders
+    // that see them have their attacks removed now and added back at the end
+    Bitboard changed = (1ULL << from) | (1ULL << to);
+    if((move&0xF000) == 0x2000) changed |= 1ULL << (to - pawn_push_offset<side>);
+    if((move&0xF000) == 0x8000) changed |= cstl_rook_delta[to];
+
+    Bitboard affected = sliders_seeing(pos, changed) | (pos.occupied() & changed);
+
+    pos.history.attack_planes[pos.history.size] = pos.attack_planes;
+    update_attack_counts<false>(pos, affected);
+#endif
+
     pos.push_history(moved, target, move);
 
-    // Change the mailbox first, since this might need overwritng in case of promotions
+    // If there is an en_passant square, it will be removed from the key regardless what move is played
+    if(pos.en_passant) pos.position_key ^= rnd_value_array[enp_rnd_id + pos.en_passant];
+    pos.en_passant = 0;
+
+    // Move the piece in the mailbox, the bitboards and the key
     pos.board[to] = moved;
     pos.board[from] = no_piece;
 
-    // If there is an en_passant square, it will be removed from the key regardless what move is played
-    if(pos.en_passant) pos.position_key ^= rnd_value_array[enp_rnd_id + pos.en_passant];
+    move_piece(pos, from, to, moved);
+
+    pos.position_key ^= rnd_value_array[64*moved + from]
+                        ^ rnd_value_array[64*moved + to]
+                        ^ rnd_value_array[64*target + to];
+
+    // The pawn key changes for pawn moves and captured pawns
+    if((moved&type_mask) == pawn){
+        pos.pawn_key ^= rnd_value_array[64*moved + from] ^ rnd_value_array[64*moved + to];
+    }
+    if((target&type_mask) == pawn) pos.pawn_key ^= rnd_value_array[64*target + to];
 
-    // pos.halfmove_clock = (((moved&type_mask) == pawn)) ? 0 : pos.halfmove_clock + 1;
+    // No change if nothing is captured, the delta of the empty square is 0
+    pos.material_key -= material_key_delta[target];
+
+    update_psqt<-1>(pos, moved, from);
+    update_psqt<1>(pos, moved, to);
+    update_psqt<-1>(pos, target, to);
+
+    // If there was a piece captured, remove it from its boards
+    if(target){
+        pos.halfmove_clock = 0;
+        remove_piece(pos, to, target);
+    }
+    else if((moved&type_mask) == pawn) pos.halfmove_clock = 0;
+    else pos.halfmove_clock++;
 
     // Now handle special cases
     switch (move&0xF000)
     {
     case 0:
-        pos.en_passant = 0;
-        break;
-    case 0x8000:
-        // CASTLING
-        if(from < 8){ //white
-            if(to > from){ //kingside
-                pos.board[H1] = no_piece;
-                pos.board[F1] = w_rook;
-
-                move_piece(pos, H1, F1, no_piece);
-                move_piece(pos, H1, F1, w_rook);
-                move_piece(pos, H1, F1, w_piece);
-
-                // Update the position key
-                pos.position_key ^= rnd_value_array[64*w_rook + H1] 
-                                    ^ rnd_value_array[64*w_rook + F1];
-            }
-            else{
-                pos.board[A1] = no_piece;
-                pos.board[D1] = w_rook;
-
-                move_piece(pos, A1, D1, no_piece);
-                move_piece(pos, A1, D1, w_rook);
-                move_piece(pos, A1, D1, w_piece);
-
-                // Update the position key
-                pos.position_key ^= rnd_value_array[64*w_rook + A1] 
-                                    ^ rnd_value_array[64*w_rook + D1];
-            }
-            pos.castling_rights &= 0b1100;
-        }
-        else{ //black
-            if(to > from){ //kingside
-                pos.board[H8] = no_piece;
-                pos.board[F8] = b_rook;
-                /*
-                pos.piece_bitboards[b_rook] ^= (1ULL << H8) | (1ULL << F8);
-                pos.piece_bitboards[no_piece] ^= (1ULL << H8) | (1ULL << F8);
-                pos.piece_bitboards[b_piece] ^= (1ULL << H8) | (1ULL << F8);
-                */
-                move_piece(pos, H8, F8, no_piece);
-                move_piece(pos, H8, F8, b_rook);
-                move_piece(pos, H8, F8, b_piece);
-                // Update the position key
-                pos.position_key ^= rnd_value_array[64*b_rook + H8] 
-                                    ^ rnd_value_array[64*b_rook + F8];
-            }
-            else{
-                pos.board[A8] = no_piece;
-                pos.board[D8] = b_rook;
-                /*
-                pos.piece_bitboards[b_rook] ^= (1ULL << A8) | (1ULL << D8);
-                pos.piece_bitboards[no_piece] ^= (1ULL << A8) | (1ULL << D8);
-                pos.piece_bitboards[b_piece] ^= (1ULL << A8) | (1ULL << D8);
-                */
-                move_piece(pos, A8, D8, no_piece);
-                move_piece(pos, A8, D8, b_rook);
-                move_piece(pos, A8, D8, b_piece);
-                // Update the position key
-                pos.position_key ^= rnd_value_array[64*b_rook + A8] 
-                                    ^ rnd_value_array[64*b_rook + D8];
-            }
-            pos.castling_rights &= 0b0011;
-        }
-        pos.en_passant = 0;
         break;
     case 0x1000:
-        // SET EN PASSANT SQUARE, THEN CONTINUE AS NORMAL
-        if(pos.to_move){
-            pos.en_passant = (to + 8);
-        }
-        else{
-            pos.en_passant = (to - 8);
-        }
-        // Update position key if there is an en passant square
+        // SET EN PASSANT SQUARE
+        pos.en_passant = to - pawn_push_offset<side>;
         pos.position_key ^= rnd_value_array[enp_rnd_id + pos.en_passant];
         break;
     case 0x2000:
         // EN PASSANT CAPTURE
-        if(pos.to_move){
-
-            remove_piece(pos, to + 8, no_piece);
-            remove_piece(pos, to + 8, w_pawn);
-            remove_piece(pos, to + 8, w_piece);
-
-            pos.board[to + 8] = no_piece;
-            // Update the positon key
-            pos.position_key ^= rnd_value_array[64*w_pawn + to + 8];
-        }
-        else{
-
-            remove_piece(pos, to - 8, no_piece);
-            remove_piece(pos, to - 8, b_pawn);
-            remove_piece(pos, to - 8, b_piece);
-
-            pos.board[to - 8] = no_piece;
-            // Update the position key
-            pos.position_key ^= rnd_value_array[64*b_pawn + to + 8];
-        }
-        pos.en_passant = 0;
-        break;
-    case 0x3000: 
-        // PROMOTE TO KNIGHT
-        pos.board[to] = pos.board[to] + 1; // Pawn to knight
-
-        place_piece(pos, to, moved +1);
-        remove_piece(pos, to, moved);
-
-        pos.en_passant = 0;
-        // Update the positon key
-        pos.position_key ^= rnd_value_array[64*(moved + 1) + to]
-                            ^ rnd_value_array[64*moved + to];
+        toggle_en_passant_victim<side>(pos, to);
+        pos.board[to - pawn_push_offset<side>] = no_piece;
+        pos.position_key ^= rnd_value_array[64*(pawn | opponent<side>) + to - pawn_push_offset<side>];
+        pos.pawn_key ^= rnd_value_array[64*(pawn | opponent<side>) + to - pawn_push_offset<side>];
+        pos.material_key -= material_key_delta[pawn | opponent<side>];
+        update_psqt<-1>(pos, pawn | opponent<side>, to - pawn_push_offset<side>);
         break;
-    case 0x4000:
-        // PROMOTE TO BISHOP
-        pos.board[to] = pos.board[to] + 2; // Pawn to bishop
-
-        place_piece(pos, to, moved +2);
-        remove_piece(pos, to, moved);
-
-        pos.en_passant = 0;
-        // Update the positon key
-        pos.position_key ^= rnd_value_array[64*(moved + 2) + to]
-                            ^ rnd_value_array[64*moved + to];
+    case 0x8000:
+        // CASTLING
+        make_castling<side>(pos, to);
         break;
-    case 0x5000:
-        // PROMOTE TO ROOK
-        pos.board[to] = pos.board[to] + 3; // Pawn to rook
+    default:{
+        // PROMOTION, 0x3000 is a knight up to 0x6000 for a queen
+        Piece promoted = moved + ((move >> 12) - 2);
 
-        place_piece(pos, to, moved +3);
-        remove_piece(pos, to, moved);
+        pos.board[to] = promoted;
 
-        pos.en_passant = 0;
-        // Update the positon key
-        pos.position_key ^= rnd_value_array[64*(moved + 3) + to]
-                            ^ rnd_value_array[64*moved + to];
-        break;
-    case 0x6000:
-        // PROMOTE TO QUEEN
-        pos.board[to] = pos.board[to] + 4; // Pawn to queen
+        // The color stays the same, only the type changes
+        pos.type_bitboards[pawn - 1] ^= 1ULL << to;
+        pos.type_bitboards[(promoted&type_mask) - 1] ^= 1ULL << to;
 
-        place_piece(pos, to, moved +4);
-        remove_piece(pos, to, moved);
-
-        pos.en_passant = 0;
-        // Update the positon key
-        pos.position_key ^= rnd_value_array[64*(moved + 4) + to]
+        pos.position_key ^= rnd_value_array[64*promoted + to]
                             ^ rnd_value_array[64*moved + to];
+        pos.pawn_key ^= rnd_value_array[64*moved + to];
+        pos.material_key += material_key_delta[promoted] - material_key_delta[moved];
+        update_psqt<-1>(pos, moved, to);
+        update_psqt<1>(pos, promoted, to);
         break;
-    default:
-        pos.en_passant = 0;
-        break;
-    }
-
-    // Then change the bitboards
-    place_piece (pos, from,     no_piece);
-    remove_piece(pos,       to, target  );
-    move_piece  (pos, from, to, moved   );
-    
-
-    // Occupancy bitboards need updating
-    move_piece(pos, from, to, w_piece | pos.to_move);
-
-    // If there was a piece captured, change the opposing colors occpuancy
-    if(target){
-        pos.halfmove_clock = 0;
-        remove_piece(pos, to, b_piece ^ pos.to_move);
+        }
     }
-    else if((moved&type_mask) == pawn) pos.halfmove_clock = 0;
-    else pos.halfmove_clock++;
 
     // Update Castling rights
     pos.castling_rights &= cstl_array[from]&cstl_array[to];
+    pos.position_key ^= cstl_key_delta[old_rights ^ pos.castling_rights];
 
     // Change side to move
-    pos.to_move = black - pos.to_move;
-
-    // Last update the key
-    pos.position_key ^= rnd_value_array[to_move_rnd_id] 
-                        ^ rnd_value_array[64*moved + from]
-                        ^ rnd_value_array[64*moved + to]
-                        ^ rnd_value_array[64*target + to];
+    pos.to_move = opponent<side>;
+    pos.position_key ^= rnd_value_array[to_move_rnd_id];
 
-    UndoObject undo = pos.get_last_history();
-    if(undo.castling_rights ^ pos.castling_rights){
-        // Remove castling rights from hash if they are different
-        uint8_t cstl_difference = undo.castling_rights^pos.castling_rights;
-        while(cstl_difference){
-            pos.position_key ^= rnd_value_array[cstl_K_rnd_id + get_lsb(cstl_difference) - 1];
-            cstl_difference &= cstl_difference - 1;
-        }
-    }
+#ifdef ATTACK_COUNTS
+    update_attack_counts<true>(pos, (affected | changed) & pos.occupied());
+#endif
 
-    // Return Undo instructions
     return true;
 }
 
+// side is the color that made the move which is taken back
+template <PieceColor side>
 void unmake_move(Position& pos){
+#ifdef COPY_MAKE
+    pos.pop_snapshot();
+#endif
     UndoObject undo = pos.pop_history();
-    Square from = undo.move&0b111111;
-    Square to = (undo.move >> 6)&0b111111;
-
-    //Piece moved_piece = pos.board[to];
 
     // Change side to move back
-    pos.to_move = black - pos.to_move;
+    pos.to_move = side;
 
     // load en passant state and castling rights
     pos.en_passant = undo.en_passant_sq;
     pos.castling_rights = undo.castling_rights;
     pos.halfmove_clock = undo.halfmove_clock;
 
-    // Recover key
+    // Recover keys
     pos.position_key = undo.position_key;
+    pos.pawn_key = undo.pawn_key;
+
+#ifdef ATTACK_COUNTS
+    pos.attack_planes = pos.history.attack_planes[pos.history.size];
+#endif
+
+#ifndef COPY_MAKE
+    Square from = from_square(undo.move);
+    Square to = to_square(undo.move);
 
     // special undo operations for special moves
     switch (undo.move&0xF000)
     {
     case 0:
-        break;
-    case 0x8000:
-        // CASTLING
-        if(from < 8){ //white
-            if(to > from){ //kingside
-                //basically an additional rook move has to be made, but it is always the same one
-                pos.board[F1] = no_piece;
-                pos.board[H1] = w_rook;
-
-                move_piece(pos, H1, F1, no_piece);
-                move_piece(pos, H1, F1, w_rook);
-                move_piece(pos, H1, F1, w_piece);
-            }
-            else{
-                pos.board[D1] = no_piece;
-                pos.board[A1] = w_rook;
-
-                move_piece(pos, A1, D1, no_piece);
-                move_piece(pos, A1, D1, w_rook);
-                move_piece(pos, A1, D1, w_piece);
-            }
-        }
-        else{ //black
-            if(to > from){ //kingside
-                pos.board[F8] = no_piece;
-                pos.board[H8] = b_rook;
-
-                move_piece(pos, H8, F8, no_piece);
-                move_piece(pos, H8, F8, b_rook);
-                move_piece(pos, H8, F8, b_piece);
-            }
-            else{
-                pos.board[D8] = no_piece;
-                pos.board[A8] = b_rook;
-
-                move_piece(pos, A8, D8, no_piece);
-                move_piece(pos, A8, D8, b_rook);
-                move_piece(pos, A8, D8, b_piece);
-            }
-        }
+    case 0x1000:
         break;
     case 0x2000:
         // EN PASSANT CAPTURE
-        if(pos.to_move){
-
-            place_piece(pos, to + 8, no_piece);
-            place_piece(pos, to + 8, w_pawn);
-            place_piece(pos, to + 8, w_piece);
-
-            pos.board[to + 8] = w_pawn;
-        }
-        else{
-
-            place_piece(pos, to - 8, no_piece);
-            place_piece(pos, to - 8, b_pawn);
-            place_piece(pos, to - 8, b_piece);
-
-            pos.board[to - 8] = b_pawn;
-        }
-        break;
-    case 0x3000:
-        // PROMOTE TO KNIGHT
-        remove_piece(pos, to, undo.moved_piece +1);
-        // moved_piece -= 1;
-        place_piece(pos, to, undo.moved_piece);
-
+        toggle_en_passant_victim<side>(pos, to);
+        pos.board[to - pawn_push_offset<side>] = pawn | opponent<side>;
+        pos.material_key += material_key_delta[pawn | opponent<side>];
+        update_psqt<1>(pos, pawn | opponent<side>, to - pawn_push_offset<side>);
         break;
-    case 0x4000:
-        // PROMOTE TO BISHOP
-        remove_piece(pos, to, undo.moved_piece + 2);
-        //moved_piece -= 2;
-        place_piece(pos, to, undo.moved_piece);
-
-        break;
-    case 0x5000:
-        // PROMOTE TO ROOK
-        remove_piece(pos, to, undo.moved_piece + 3);
-        //moved_piece -= 3;
-        place_piece(pos, to, undo.moved_piece);
-
-        break;
-    case 0x6000:
-        // PROMOTE TO QUEEN
-        remove_piece(pos, to, undo.moved_piece + 4);
-        // moved_piece -= 4;
-        place_piece(pos, to, undo.moved_piece);
-
+    case 0x8000:
+        // CASTLING
+        unmake_castling<side>(pos, to);
         break;
-    default:
+    default:{
+        // PROMOTION, turn the piece back into a pawn
+        Piece promoted = undo.moved_piece + ((undo.move >> 12) - 2);
+
+        pos.type_bitboards[pawn - 1] ^= 1ULL << to;
+        pos.type_bitboards[(promoted&type_mask) - 1] ^= 1ULL << to;
+        pos.material_key -= material_key_delta[promoted] - material_key_delta[undo.moved_piece];
+        update_psqt<-1>(pos, promoted, to);
+        update_psqt<1>(pos, undo.moved_piece, to);
         break;
+        }
     }
 
     // Undo changes to the mailbox
@@ -367,22 +302,34 @@ void unmake_move(Position& pos){
     pos.board[to] = undo.target_piece;
 
     // Undo changes to the bitboards
-    remove_piece(pos, from,          no_piece    );
-    place_piece (pos,       to, undo.target_piece);
-    move_piece  (pos, from, to, undo.moved_piece );
-    
-
+    move_piece(pos, from, to, undo.moved_piece);
 
-    // After changing back the side to move, undo the occupancy changes    
-    move_piece(pos, from, to, w_piece | pos.to_move);
+    update_psqt<-1>(pos, undo.moved_piece, to);
+    update_psqt<1>(pos, undo.moved_piece, from);
 
-    // If there was a piece captured, change the opposing colors occpuancy back as well
+    // If there was a piece captured, put it back
     if(undo.target_piece){
-        place_piece(pos, to, b_piece ^ pos.to_move);
+        place_piece(pos, to, undo.target_piece);
+        pos.material_key += material_key_delta[undo.target_piece];
+        update_psqt<1>(pos, undo.target_piece, to);
     }
+#endif
+}
 
+bool make_move(Position& pos, Move move){
+#ifdef COPY_MAKE
+    pos.push_snapshot();
+#endif
+    if(pos.to_move) return make_move<black>(pos, move);
+    else            return make_move<white>(pos, move);
+}
+
+void unmake_move(Position& pos){
+    // The side to move is the opponent of the side that played the move
+    if(pos.to_move) unmake_move<white>(pos);
+    else            unmake_move<black>(pos);
 }
 
 
 
-#endif // MAKE_UNMAKE
\ No newline at end of file
+#endif // MAKE_UNMAKE
@@ -0,0 +1,134 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <array>
+#include <algorithm>
+
+#include "types.h"
+#include "position.h"
+#include "position_tables.h"
+#include "endgame.h"
+
+/*
+Everything the eval needs to know about the material alone, looked up by
+the material key of the position: the game phase, the imbalance terms,
+an endgame evaluator for the endgames in endgame.h and scale factors for
+drawish material (a side without pawns can not win with a lone minor piece
+or two knights, and hardly by a minor piece more). Only a few material
+signatures come up in a search, so the table is small and a lookup is
+almost always a hit.
+*/
+
+// Returns the score from white's point of view, replaces the normal eval
+typedef int (*EndgameEval)(const Position&);
+
+// Bishop pair, and knights get better and rooks worse with more own pawns
+constexpr int bishop_pair_bonus = 30;
+constexpr int knight_pawn_bonus = 6;    // per pawn above 5
+constexpr int rook_pawn_penalty = 12;   // per pawn above 5
+
+// Scale out of 64 for the side that is ahead without pawns and by a minor piece at most
+constexpr int no_pawns_scale = 16;
+
+struct MaterialEntry{
+    uint64_t key;
+    EndgameEval evaluate;
+    // From white's point of view in centipawns
+    int16_t imbalance;
+    // Weight of the endgame scores out of 256
+    uint16_t phase;
+    // Out of 64, used for the side that is ahead, 0 if it can not win
+    uint8_t white_scale;
+    uint8_t black_scale;
+
+    bool is_draw() const {return (white_scale == 0) && (black_scale == 0);}
+};
+
+// 1024 entries of 24 bytes
+constexpr short material_tbl_idx_len = 10;
+constexpr unsigned long material_tbl_size = 1UL << material_tbl_idx_len;
+
+static std::array<MaterialEntry, material_tbl_size> material_table;
+
+// Material keys only have a few bits set, so they are mixed before indexing
+inline unsigned long material_index(uint64_t material_key){
+    return (material_key*0x9E3779B97F4A7C15ULL) >> (64 - material_tbl_idx_len);
+}
+
+template <PieceColor side>
+int material_imbalance(uint64_t key){
+    int pawns = piece_count(key, pawn | side);
+    int score = 0;
+
+    if(piece_count(key, bishop | side) >= 2) score += bishop_pair_bonus;
+    score += (pawns - 5)*(knight_pawn_bonus*piece_count(key, knight | side)
+                          - rook_pawn_penalty*piece_count(key, rook | side));
+    return score;
+}
+
+// The endgame evaluator if the strong side has this material against a lone king
+template <PieceColor strong>
+EndgameEval lone_king_evaluator(uint64_t key){
+    int pawns = piece_count(key, pawn | strong);
+    int knights = piece_count(key, knight | strong);
+    int bishops = piece_count(key, bishop | strong);
+    int majors = piece_count(key, rook | strong) + piece_count(key, queen | strong);
+
+    if(majors) return evaluate_kxk<strong>;
+    if(!pawns && (knights == 1) && (bishops == 1)) return evaluate_kbnk<strong>;
+    if((pawns == 1) && !knights && !bishops) return evaluate_kpk<strong>;
+    return nullptr;
+}
+
+inline MaterialEntry compute_material_entry(uint64_t key){
+    MaterialEntry entry{key, nullptr, 0, 0, 64, 64};
+
+    int material[2] = {0, 0};
+    int pieces[2] = {0, 0};
+    for(PieceType p_type : {pawn, knight, bishop, rook, queen}){
+        for(PieceColor side : {white, black}){
+            material[side >> 3] += material_value[p_type]*piece_count(key, p_type | side);
+            if(p_type != pawn) pieces[side >> 3] += piece_count(key, p_type | side);
+        }
+    }
+
+    // 78 = opening material, the same phase the piece square tables used to be mixed with
+    entry.phase = std::clamp((78 - material[0] - material[1])*256/78, 0, 256);
+
+    entry.imbalance = material_imbalance<white>(key) - material_imbalance<black>(key);
+
+    bool white_bare = (material[0] == 0);
+    bool black_bare = (material[1] == 0);
+
+    if(black_bare && !white_bare) entry.evaluate = lone_king_evaluator<white>(key);
+    if(white_bare && !black_bare) entry.evaluate = lone_king_evaluator<black>(key);
+
+    // Without pawns a side needs more than a minor piece to win
+    for(PieceColor side : {white, black}){
+        int own = side >> 3;
+        if(piece_count(key, pawn | side)) continue;
+
+        uint8_t scale = 64;
+        if(material[own] - material[own ^ 1] <= 3) scale = no_pawns_scale;
+
+        // No mating material at all: a lone minor piece, two knights or nothing
+        bool two_knights = (pieces[own] == 2) && (piece_count(key, knight | side) == 2);
+        bool majors = piece_count(key, rook | side) || piece_count(key, queen | side);
+        if(((pieces[own] <= 1) && !majors) || two_knights) scale = 0;
+
+        if(side == white) entry.white_scale = scale;
+        else entry.black_scale = scale;
+    }
+
+    return entry;
+}
+
+inline const MaterialEntry& probe_material_table(const Position& pos){
+    MaterialEntry& entry = material_table[material_index(pos.material_key)];
+
+    // The key of the empty table entries is 0, which is no position with two kings
+    if(entry.key != pos.material_key) entry = compute_material_entry(pos.material_key);
+    return entry;
+}
+
+#endif // MATERIAL_H
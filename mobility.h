@@ -0,0 +1,87 @@
+#ifndef MOBILITY_H
+#define MOBILITY_H
+
+#include <array>
+#include <algorithm>
+
+#include "types.h"
+#include "utility.h"
+#include "bitboard.h"
+#include "position.h"
+
+/*
+Mobility and attacks on the king zone, both from the attacks of every
+single piece. The slider attacks come from slider_attacks_batch, which
+fills four sliders at once with AVX2. Queens are in the rook and in the
+bishop batch at the same index, so both halves can be joined again.
+
+Mobility counts the squares that are not taken by own pieces or attacked
+by enemy pawns. Each piece type has a weight per square above the count
+it usually has.
+
+The pieces that attack the enemy king zone add their attack weight and
+the number of zone squares they attack. Two attackers or more turn
+the sum into a penalty for the defender that grows with its square.
+*/
+
+// Indexed by piece type, queens count the squares of both lines
+constexpr std::array<int, 7> mobility_opening = {0, 0, 4, 5, 2, 1, 0};
+constexpr std::array<int, 7> mobility_endgame = {0, 0, 4, 5, 4, 2, 0};
+constexpr std::array<int, 7> mobility_center  = {0, 0, 4, 6, 6, 12, 0};
+
+constexpr std::array<int, 7> king_attack_weight = {0, 0, 2, 2, 3, 5, 0};
+constexpr int king_attack_max_penalty = 500;
+
+// Up to 9 queens and 10 of each other piece with promotions
+constexpr int max_batch = 10;
+
+template <PieceColor side>
+inline void evaluate_mobility(const Position& pos, int& opening, int& endgame){
+    constexpr PieceColor enemy = opponent<side>;
+    constexpr int sign = (side == white) ? 1 : -1;
+
+    Bitboard occupied = pos.occupied();
+    Bitboard area = ~pos.color_pieces(side) & ~pawn_attacks<enemy>(pos.pieces(pawn | enemy));
+    Bitboard zone = king_zone[enemy >> 3][get_lsb(pos.pieces(king | enemy)) - 1];
+
+    // Queens first in both batches, so the queen at index i has its halves at i in both
+    std::array<Square, max_batch + 1> rook_squares, bishop_squares;
+    int queens = 0, rooks = 0, bishops = 0;
+    for(Bitboard bb = pos.pieces(queen | side); bb; bb &= bb - 1){
+        rook_squares[queens] = bishop_squares[queens] = get_lsb(bb) - 1;
+        queens++;
+    }
+    rooks = bishops = queens;
+    for(Bitboard bb = pos.pieces(rook | side); bb && (rooks < max_batch); bb &= bb - 1) rook_squares[rooks++] = get_lsb(bb) - 1;
+    for(Bitboard bb = pos.pieces(bishop | side); bb && (bishops < max_batch); bb &= bb - 1) bishop_squares[bishops++] = get_lsb(bb) - 1;
+
+    std::array<Bitboard, max_batch + 1> rook_lines, bishop_lines;
+    slider_attacks_batch<true>(rook_squares.data(), rooks, occupied, rook_lines.data());
+    slider_attacks_batch<false>(bishop_squares.data(), bishops, occupied, bishop_lines.data());
+
+    std::array<int, 7> squares{};
+    int attackers = 0;
+    int attack_units = 0;
+
+    auto add_piece = [&](PieceType p_type, Bitboard attacks){
+        squares[p_type] += count_bits(attacks & area) - mobility_center[p_type];
+        if(attacks & zone){
+            attackers++;
+            attack_units += king_attack_weight[p_type] + count_bits(attacks & zone);
+        }
+    };
+
+    for(int i = 0; i < queens; i++) add_piece(queen, rook_lines[i] | bishop_lines[i]);
+    for(int i = queens; i < rooks; i++) add_piece(rook, rook_lines[i]);
+    for(int i = queens; i < bishops; i++) add_piece(bishop, bishop_lines[i]);
+    for(Bitboard bb = pos.pieces(knight | side); bb; bb &= bb - 1) add_piece(knight, knight_attacks[get_lsb(bb) - 1]);
+
+    for(PieceType p_type : {knight, bishop, rook, queen}){
+        opening += sign*mobility_opening[p_type]*squares[p_type];
+        endgame += sign*mobility_endgame[p_type]*squares[p_type];
+    }
+
+    if(attackers >= 2) opening += sign*std::min(attack_units*attack_units, king_attack_max_penalty);
+}
+
+#endif // MOBILITY_H
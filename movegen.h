@@ -12,148 +12,124 @@
 
 
 // These functions generate moves and add them to the Move
-inline void pawn_quiet_white(Bitboard pieces, const Bitboard& targets, MoveList* move_list){
+template <PieceColor side>
+inline void pawn_quiet(Bitboard pieces, const Bitboard& targets, MoveList* move_list){
+    constexpr int offset = pawn_push_offset<side>;
+
     // First look at all pawns that are not on the 7th rank
-    Bitboard moves = pawn_push_north(pieces&non_promoting_w) & targets;
-    Bitboard double_push = pawn_push_north(moves & __3_RANK) & targets;
+    Bitboard moves = pawn_push<side>(pieces&pawn_non_promoting<side>) & targets;
+    Bitboard double_push = pawn_push<side>(moves & pawn_double_rank<side>) & targets;
     Square sq;
 
     while(double_push){
         sq = get_lsb(double_push) - 1;
-        move_list->move_stack[move_list->size++] = (sq - 16) | (sq << 6) | 0x1000; // Add set en passant flag
+        move_list->move_stack[move_list->size++] = (sq - 2*offset) | (sq << 6) | 0x1000; // Add set en passant flag
         double_push &= double_push - 1;
     }
 
     while(moves){
         sq = get_lsb(moves) - 1;
-        move_list->move_stack[move_list->size++] = (sq - 8) | (sq << 6);
+        move_list->move_stack[move_list->size++] = (sq - offset) | (sq << 6);
         moves &= moves - 1;
     }
 
     // Take special care for the pawns that are promoting 
-    moves = pawn_push_north(pieces&__7_RANK) & targets;
+    moves = pawn_push<side>(pieces&pawn_promotion_rank<side>) & targets;
 
     while(moves){
         sq = get_lsb(moves) - 1;
-        move_list->move_stack[move_list->size++] = (sq - 8) | (sq << 6) | 0x6000;
-        move_list->move_stack[move_list->size++] = (sq - 8) | (sq << 6) | 0x5000;
-        move_list->move_stack[move_list->size++] = (sq - 8) | (sq << 6) | 0x4000;
-        move_list->move_stack[move_list->size++] = (sq - 8) | (sq << 6) | 0x3000;
+        move_list->move_stack[move_list->size++] = (sq - offset) | (sq << 6) | 0x6000;
+        move_list->move_stack[move_list->size++] = (sq - offset) | (sq << 6) | 0x5000;
+        move_list->move_stack[move_list->size++] = (sq - offset) | (sq << 6) | 0x4000;
+        move_list->move_stack[move_list->size++] = (sq - offset) | (sq << 6) | 0x3000;
         moves &= moves - 1;
     }
     
 }
 
-inline void pawn_quiet_black(Bitboard pieces, const Bitboard& targets, MoveList* move_list){
-    Bitboard moves = pawn_push_south(pieces&non_promoting_b) & targets;
-    Bitboard double_push = pawn_push_south(moves & __6_RANK) & targets;
-    Square sq;
-
-    while(double_push){
-        sq = get_lsb(double_push) - 1;
-        move_list->move_stack[move_list->size++] = (sq + 16) | (sq << 6) | 0x1000; // Add set en passant flag
-        double_push &= double_push - 1;
-    }
-
-    while(moves){
-        sq = get_lsb(moves) - 1;
-        move_list->move_stack[move_list->size++] = (sq + 8) | (sq << 6);
-        moves &= moves - 1;
-    }
-
-    moves = pawn_push_south(pieces&__2_RANK) & targets;
+template <PieceColor side>
+inline void pawn_captures(Bitboard pieces, const Bitboard& targets, MoveList* move_list){
+    constexpr int west = pawn_west_offset<side>;
+    constexpr int east = pawn_east_offset<side>;
 
-    while(moves){
-        sq = get_lsb(moves) - 1;
-        move_list->move_stack[move_list->size++] = (sq + 8) | (sq << 6) | 0x6000;
-        move_list->move_stack[move_list->size++] = (sq + 8) | (sq << 6) | 0x5000;
-        move_list->move_stack[move_list->size++] = (sq + 8) | (sq << 6) | 0x4000;
-        move_list->move_stack[move_list->size++] = (sq + 8) | (sq << 6) | 0x3000;
-        moves &= moves - 1;
-    }
-
-}
-
-inline void pawn_captures_white(Bitboard pieces, const Bitboard& targets, MoveList* move_list){
     // Shift pawns and then extract moves
-    Bitboard moves = pawn_north_west(pieces&non_promoting_w) & targets;
+    Bitboard moves = pawn_west<side>(pieces&pawn_non_promoting<side>) & targets;
     Square sq;
 
     while(moves){
         sq = get_lsb(moves) - 1;
         // Only one pawn can be the attacker of this square from this direction
-        move_list->move_stack[move_list->size++] = (sq - 7) | (sq << 6);
+        move_list->move_stack[move_list->size++] = (sq - west) | (sq << 6);
         moves &= moves - 1;
     }
     // Pieces on the 7th rank are promoting, so 4 moves are generated
-    moves = pawn_north_west(pieces&__7_RANK) & targets;
+    moves = pawn_west<side>(pieces&pawn_promotion_rank<side>) & targets;
     while(moves){
         sq = get_lsb(moves) - 1;
         // Only one pawn can be the attacker of this square from this direction
-        move_list->move_stack[move_list->size++] = (sq - 7) | (sq << 6) | 0x6000;
-        move_list->move_stack[move_list->size++] = (sq - 7) | (sq << 6) | 0x5000;
-        move_list->move_stack[move_list->size++] = (sq - 7) | (sq << 6) | 0x4000;
-        move_list->move_stack[move_list->size++] = (sq - 7) | (sq << 6) | 0x3000;
+        move_list->move_stack[move_list->size++] = (sq - west) | (sq << 6) | 0x6000;
+        move_list->move_stack[move_list->size++] = (sq - west) | (sq << 6) | 0x5000;
+        move_list->move_stack[move_list->size++] = (sq - west) | (sq << 6) | 0x4000;
+        move_list->move_stack[move_list->size++] = (sq - west) | (sq << 6) | 0x3000;
         moves &= moves - 1;
     }
 
-    moves = pawn_north_east(pieces&non_promoting_w)& targets;
+    moves = pawn_east<side>(pieces&pawn_non_promoting<side>)& targets;
     while(moves){
         sq = get_lsb(moves) - 1;
-        move_list->move_stack[move_list->size++] = (sq - 9) | (sq << 6);
+        move_list->move_stack[move_list->size++] = (sq - east) | (sq << 6);
         moves &= moves - 1;
     }
 
-    moves = pawn_north_east(pieces&__7_RANK)& targets;
+    moves = pawn_east<side>(pieces&pawn_promotion_rank<side>)& targets;
     while(moves){
         sq = get_lsb(moves) - 1;
-        move_list->move_stack[move_list->size++] = (sq - 9) | (sq << 6) | 0x3000;
-        move_list->move_stack[move_list->size++] = (sq - 9) | (sq << 6) | 0x4000;
-        move_list->move_stack[move_list->size++] = (sq - 9) | (sq << 6) | 0x5000;
-        move_list->move_stack[move_list->size++] = (sq - 9) | (sq << 6) | 0x6000;
+        move_list->move_stack[move_list->size++] = (sq - east) | (sq << 6) | 0x3000;
+        move_list->move_stack[move_list->size++] = (sq - east) | (sq << 6) | 0x4000;
+        move_list->move_stack[move_list->size++] = (sq - east) | (sq << 6) | 0x5000;
+        move_list->move_stack[move_list->size++] = (sq - east) | (sq << 6) | 0x6000;
         moves &= moves - 1;
     }
 
 }
 
-inline void pawn_captures_black(Bitboard pieces, const Bitboard& targets, MoveList* move_list){
-    Bitboard moves = pawn_south_west(pieces&non_promoting_b) & targets;
-    Square sq;
+template <PieceColor side>
+inline void en_passant_captures(const Position& pos, MoveList* move_list){
+    constexpr int west = pawn_west_offset<side>;
+    constexpr int east = pawn_east_offset<side>;
+    Square ep = pos.en_passant;
 
-    while(moves){
-        sq = get_lsb(moves) - 1;
-        move_list->move_stack[move_list->size++] = (sq + 9) | (sq << 6);
-        moves &= moves - 1;
-    }
+    if(!ep) return;
 
-    moves = pawn_south_west(pieces&__2_RANK) & targets;
-    while(moves){
-        sq = get_lsb(moves) - 1;
-        move_list->move_stack[move_list->size++] = (sq + 9) | (sq << 6) | 0x6000;
-        move_list->move_stack[move_list->size++] = (sq + 9) | (sq << 6) | 0x5000;
-        move_list->move_stack[move_list->size++] = (sq + 9) | (sq << 6) | 0x4000;
-        move_list->move_stack[move_list->size++] = (sq + 9) | (sq << 6) | 0x3000;
-        moves &= moves - 1;
+    // A west capture can not land on the h-file and an east capture not on the a-file
+    if(((ep&0b111) != 7) && (pos.board[ep - west] == (pawn | side))){
+        move_list->move_stack[move_list->size++] = (ep - west) | (ep << 6) | 0x2000;
+    }
+    if(((ep&0b111) != 0) && (pos.board[ep - east] == (pawn | side))){
+        move_list->move_stack[move_list->size++] = (ep - east) | (ep << 6) | 0x2000;
     }
+}
 
+template <PieceColor side>
+inline void castling_moves(const Position& pos, MoveList* move_list, AttackInfo& attack_info){
+    if(!(pos.castling_rights&cstl_side<side>)) return;
 
-    moves = pawn_south_east(pieces&non_promoting_b)& targets;
-    while(moves){
-        sq = get_lsb(moves) - 1;
-        move_list->move_stack[move_list->size++] = (sq + 7) | (sq << 6);
-        moves &= moves - 1;
+    // The attacked squares are only needed if the squares in between are free
+    if(pos.castling_rights&cstl_queenside<side>){ 
+        // Now first check if there is a possibility for queenside castle
+        if(!(pos.occupied()&cstl_squares_queenside<side>)){ // In between squares must be free
+            if(!(cstl_traverse_queenside<side>&attack_info.attacked(opponent<side>))){ // The squares that the king needs to pass must not be attacked
+                move_list->move_stack[move_list->size++] = cstl_move_queenside<side>;
+            }
+        }
     }
-
-    moves = pawn_south_east(pieces&__2_RANK)& targets;
-    while(moves){
-        sq = get_lsb(moves) - 1;
-        move_list->move_stack[move_list->size++] = (sq + 7) | (sq << 6) | 0x3000;
-        move_list->move_stack[move_list->size++] = (sq + 7) | (sq << 6) | 0x4000;
-        move_list->move_stack[move_list->size++] = (sq + 7) | (sq << 6) | 0x5000;
-        move_list->move_stack[move_list->size++] = (sq + 7) | (sq << 6) | 0x6000;
-        moves &= moves - 1;
+    if(pos.castling_rights&cstl_kingside<side>){ 
+        if(!(pos.occupied()&cstl_squares_kingside<side>)){
+            if(!(cstl_traverse_kingside<side>&attack_info.attacked(opponent<side>))){
+                move_list->move_stack[move_list->size++] = cstl_move_kingside<side>;
+            }
+        }
     }
-
 }
 
 inline void knight_moves(Bitboard pieces, const Bitboard& targets, MoveList* move_list){
@@ -226,217 +202,169 @@ inline void rook_moves(Bitboard pieces, const Bitboard& targets, const Bitboard&
 
 
 // Psuedolegal moves
+// The generators are specialized on the side to move, the untemplated
+// versions below dispatch once on pos.to_move
 
-void generate_quiet(const Position& pos, MoveList* move_list){
-    uint8_t color = pos.to_move;
-
+template <PieceColor side>
+void generate_quiet(const Position& pos, MoveList* move_list, AttackInfo& attack_info){
     // Take all free squares
-    Bitboard free_squares = pos.piece_bitboards[no_piece];
+    Bitboard free_squares = pos.free_squares();
 
-    knight_moves(pos.piece_bitboards[knight | color], free_squares, move_list);
+    knight_moves(pos.pieces(knight | side), free_squares, move_list);
 
-    king_moves(pos.piece_bitboards[king | color], free_squares, move_list);
+    king_moves(pos.pieces(king | side), free_squares, move_list);
     
     // Queen Moves get generated in at the same time.
-    bishop_moves(pos.piece_bitboards[bishop | color]| pos.piece_bitboards[queen | color], 
+    bishop_moves(pos.pieces(bishop | side)| pos.pieces(queen | side), 
                 free_squares, ~free_squares, move_list);
     
-    rook_moves(pos.piece_bitboards[rook | color] | pos.piece_bitboards[queen | color], 
+    rook_moves(pos.pieces(rook | side) | pos.pieces(queen | side), 
                 free_squares, ~free_squares, move_list);
     
-    if(color){ // Black
-        pawn_quiet_black(pos.piece_bitboards[b_pawn], free_squares, move_list);
-
-        if(pos.castling_rights&(cstl_b)){ 
-            //If castling is still possible, generate attacked squares
-            Bitboard attacked_sq = attacked_squares(white, pos);
-
-            if(pos.castling_rights&cstl_q){ 
-                // Now first check if there is a possibility for queenside castle
-                if(!((~pos.piece_bitboards[no_piece])&cstl_squares_q)){ // In between squares must be free
-                    if(!(cstl_traverse_q&attacked_sq)){ // The squares that the king needs to pass must not be attacked
-                        move_list->move_stack[move_list->size++] = cstl_move_q;
-                    }
-                    
-                }
-            }
-            if(pos.castling_rights&cstl_k){ 
-                if(!((~pos.piece_bitboards[no_piece])&cstl_squares_k)){
-                    if(!(cstl_traverse_k&attacked_sq)){
-                        move_list->move_stack[move_list->size++] = cstl_move_k;
-                    }
-                }
-            }
-        }
-        
-    }
-    else{ // White
-        pawn_quiet_white(pos.piece_bitboards[w_pawn], free_squares, move_list);
-        
-        if(pos.castling_rights&(cstl_w)){ 
-            //If castling is still possible, generate attacked squares
-            Bitboard attacked_sq = attacked_squares(black, pos);
-
-            if(pos.castling_rights&cstl_Q){ 
-                // Now first check if there is a possibility for queenside castle
-                if(!((~pos.piece_bitboards[no_piece])&cstl_squares_Q)){ // In between squares must be free
-                    if(!(cstl_traverse_Q&attacked_sq)){ // The squares that the king needs to pass must not be attacked
-                        move_list->move_stack[move_list->size++] = cstl_move_Q;
-                    }
-                    
-                }
-            }
-            if(pos.castling_rights&cstl_K){ 
-                if(!((~pos.piece_bitboards[no_piece])&cstl_squares_K)){
-                    if(!(cstl_traverse_K&attacked_sq)){
-                        move_list->move_stack[move_list->size++] = cstl_move_K;
-                    }
-                }
-            }
-        }
-    }
+    pawn_quiet<side>(pos.pieces(pawn | side), free_squares, move_list);
+
+    castling_moves<side>(pos, move_list, attack_info);
 }
 
 
+template <PieceColor side>
 void generate_captures(const Position& pos, MoveList* move_list){
-    uint8_t color = pos.to_move;
-    // Targets are enemy pieces: if color is white, then the targets are black pieces
-    Bitboard targets = pos.piece_bitboards[b_piece ^ color];
+    // Targets are enemy pieces: if side is white, then the targets are black pieces
+    Bitboard targets = pos.color_pieces(opponent<side>);
     
-    knight_moves(pos.piece_bitboards[knight | color], targets, move_list);
+    knight_moves(pos.pieces(knight | side), targets, move_list);
 
-    king_moves(pos.piece_bitboards[king | color], targets, move_list);
+    king_moves(pos.pieces(king | side), targets, move_list);
     
-    bishop_moves(pos.piece_bitboards[bishop | color]| pos.piece_bitboards[queen | color], 
-                targets, ~pos.piece_bitboards[no_piece], move_list);
+    bishop_moves(pos.pieces(bishop | side)| pos.pieces(queen | side), 
+                targets, pos.occupied(), move_list);
     
-    rook_moves(pos.piece_bitboards[rook | color] | pos.piece_bitboards[queen | color], 
-                targets, ~pos.piece_bitboards[no_piece], move_list);
-
-    if(color){ // Black
-        pawn_captures_black(pos.piece_bitboards[b_pawn], targets, move_list);
-        // Handle en passant
-        if(pos.en_passant){
-            if((pos.en_passant != 16) && (pos.board[pos.en_passant + 7] == b_pawn)){
-                move_list->move_stack[move_list->size++] 
-                = (pos.en_passant + 7) | (pos.en_passant << 6) | 0x2000;
-            }
-            if((pos.en_passant != 23) && (pos.board[pos.en_passant + 9] == b_pawn)){
-                move_list->move_stack[move_list->size++] 
-                = (pos.en_passant + 9) | (pos.en_passant << 6) | 0x2000;
-            }
-        }
+    rook_moves(pos.pieces(rook | side) | pos.pieces(queen | side), 
+                targets, pos.occupied(), move_list);
+
+    pawn_captures<side>(pos.pieces(pawn | side), targets, move_list);
+    // Handle en passant
+    en_passant_captures<side>(pos, move_list);
+}
+
+// Quiet moves that give check, used on the first ply of the QS.
+// Direct checks go to the check squares of the piece type. Pieces that
+// uncover a check generate all their quiet moves, gives_check then drops
+// the ones that stay on the line to the king. Quiet promotions and castling
+// are left out.
+template <PieceColor side>
+void generate_quiet_checks(const Position& pos, MoveList* move_list, AttackInfo& attack_info){
+    constexpr int offset = pawn_push_offset<side>;
+
+    Bitboard free_squares = pos.free_squares();
+    Bitboard discoverers = attack_info.discoverers();
+    Bitboard queens = pos.pieces(queen | side) & ~discoverers;
+
+    knight_moves(pos.pieces(knight | side) & ~discoverers,
+                free_squares & attack_info.check_squares(knight), move_list);
+
+    // A queen checks along both kinds of lines, so the queen check squares are used for both
+    bishop_moves(pos.pieces(bishop | side) & ~discoverers,
+                free_squares & attack_info.check_squares(bishop), ~free_squares, move_list);
+    bishop_moves(queens, free_squares & attack_info.check_squares(queen), ~free_squares, move_list);
+
+    rook_moves(pos.pieces(rook | side) & ~discoverers,
+                free_squares & attack_info.check_squares(rook), ~free_squares, move_list);
+    rook_moves(queens, free_squares & attack_info.check_squares(queen), ~free_squares, move_list);
+
+    // The single push has to be free for the double push, but does not have to check
+    Bitboard pawn_checks = free_squares & attack_info.check_squares(pawn);
+    Bitboard moves = pawn_push<side>(pos.pieces(pawn | side) & ~discoverers & pawn_non_promoting<side>) & free_squares;
+    Bitboard double_push = pawn_push<side>(moves & pawn_double_rank<side>) & pawn_checks;
+    Square sq;
+
+    for(moves &= pawn_checks; moves; moves &= moves - 1){
+        sq = get_lsb(moves) - 1;
+        move_list->move_stack[move_list->size++] = (sq - offset) | (sq << 6);
     }
-    else{ // White
-        pawn_captures_white(pos.piece_bitboards[w_pawn], targets, move_list);
-        // Handle en passant
-        if(pos.en_passant){
-            if((pos.en_passant != 47) && (pos.board[pos.en_passant - 7] == w_pawn)){
-                move_list->move_stack[move_list->size++] 
-                = (pos.en_passant - 7) | (pos.en_passant << 6) | 0x2000;
-            }
-            if((pos.en_passant != 40) && (pos.board[pos.en_passant - 9] == w_pawn)){
-                move_list->move_stack[move_list->size++] 
-                = (pos.en_passant - 9) | (pos.en_passant << 6) | 0x2000;
-            }
-        }
+    for(; double_push; double_push &= double_push - 1){
+        sq = get_lsb(double_push) - 1;
+        move_list->move_stack[move_list->size++] = (sq - 2*offset) | (sq << 6) | 0x1000;
     }
 
-}
+    if(!discoverers) return;
+
+    int first_discovered = move_list->size;
+
+    knight_moves(pos.pieces(knight | side) & discoverers, free_squares, move_list);
+    bishop_moves((pos.pieces(bishop | side) | pos.pieces(queen | side)) & discoverers,
+                free_squares, ~free_squares, move_list);
+    rook_moves((pos.pieces(rook | side) | pos.pieces(queen | side)) & discoverers,
+                free_squares, ~free_squares, move_list);
+    pawn_quiet<side>(pos.pieces(pawn | side) & discoverers & pawn_non_promoting<side>, free_squares, move_list);
+    if(pos.pieces(king | side) & discoverers){
+        king_moves(pos.pieces(king | side), free_squares, move_list);
+    }
 
-void generate_all(const Position& pos, MoveList* move_list){
-    uint8_t color = pos.to_move;
+    int size = first_discovered;
+    for(int i = first_discovered; i < move_list->size; i++){
+        Move move = move_list->move_stack[i];
+        if(attack_info.gives_check(move)) move_list->move_stack[size++] = move;
+    }
+    // The picker stops at the first empty entry
+    for(int i = size; i < move_list->size; i++) move_list->move_stack[i] = 0;
+    move_list->size = size;
+}
 
-    Bitboard targets = pos.piece_bitboards[b_piece ^ color];
-    Bitboard free_squares = pos.piece_bitboards[no_piece];
+template <PieceColor side>
+void generate_all(const Position& pos, MoveList* move_list, AttackInfo& attack_info){
+    Bitboard targets = pos.color_pieces(opponent<side>);
+    Bitboard free_squares = pos.free_squares();
     Bitboard possible_square = targets | free_squares;
 
-    knight_moves(pos.piece_bitboards[knight | color], possible_square, move_list);
+    knight_moves(pos.pieces(knight | side), possible_square, move_list);
 
-    king_moves(pos.piece_bitboards[king | color], possible_square, move_list);
+    king_moves(pos.pieces(king | side), possible_square, move_list);
     
-    bishop_moves(pos.piece_bitboards[bishop | color]| pos.piece_bitboards[queen | color], 
-                possible_square, ~pos.piece_bitboards[no_piece], move_list);
+    bishop_moves(pos.pieces(bishop | side)| pos.pieces(queen | side), 
+                possible_square, pos.occupied(), move_list);
     
-    rook_moves(pos.piece_bitboards[rook | color] | pos.piece_bitboards[queen | color], 
-                possible_square, ~pos.piece_bitboards[no_piece], move_list);
-
-    if(color){ // Black
-        pawn_captures_black(pos.piece_bitboards[b_pawn], targets, move_list);
-        // Handle en passant
-        if(pos.en_passant){
-            if((pos.en_passant != 16) && (pos.board[pos.en_passant + 7] == b_pawn)){
-                move_list->move_stack[move_list->size++] 
-                = (pos.en_passant + 7) | (pos.en_passant << 6) | 0x2000;
-            }
-            if((pos.en_passant != 23) && (pos.board[pos.en_passant + 9] == b_pawn)){
-                move_list->move_stack[move_list->size++] 
-                = (pos.en_passant + 9) | (pos.en_passant << 6) | 0x2000;
-            }
-        }
-        pawn_quiet_black(pos.piece_bitboards[b_pawn], free_squares, move_list);
-
-        if(pos.castling_rights&(cstl_b)){ 
-            //If castling is still possible, generate attacked squares
-            Bitboard attacked_sq = attacked_squares(white, pos);
-
-            if(pos.castling_rights&cstl_q){ 
-                // Now first check if there is a possibility for queenside castle
-                if(!((~pos.piece_bitboards[no_piece])&cstl_squares_q)){ // In between squares must be free
-                    if(!(cstl_traverse_q&attacked_sq)){ // The squares that the king needs to pass must not be attacked
-                        move_list->move_stack[move_list->size++] = cstl_move_q;
-                    }
-                    
-                }
-            }
-            if(pos.castling_rights&cstl_k){ 
-                if(!((~pos.piece_bitboards[no_piece])&cstl_squares_k)){
-                    if(!(cstl_traverse_k&attacked_sq)){
-                        move_list->move_stack[move_list->size++] = cstl_move_k;
-                    }
-                }
-            }
-        }
-    }
-    else{ // White
-        pawn_captures_white(pos.piece_bitboards[w_pawn], targets, move_list);
-        // Handle en passant
-        if(pos.en_passant){
-            if((pos.en_passant != 47) && (pos.board[pos.en_passant - 7] == w_pawn)){
-                move_list->move_stack[move_list->size++] 
-                = (pos.en_passant - 7) | (pos.en_passant << 6) | 0x2000;
-            }
-            if((pos.en_passant != 40) && (pos.board[pos.en_passant - 9] == w_pawn)){
-                move_list->move_stack[move_list->size++] 
-                = (pos.en_passant - 9) | (pos.en_passant << 6) | 0x2000;
-            }
-        }
+    rook_moves(pos.pieces(rook | side) | pos.pieces(queen | side), 
+                possible_square, pos.occupied(), move_list);
 
-        pawn_quiet_white(pos.piece_bitboards[w_pawn], free_squares, move_list);
-        
-        if(pos.castling_rights&(cstl_w)){ 
-            //If castling is still possible, generate attacked squares
-            Bitboard attacked_sq = attacked_squares(black, pos);
-
-            if(pos.castling_rights&cstl_Q){ 
-                // Now first check if there is a possibility for queenside castle
-                if(!((~pos.piece_bitboards[no_piece])&cstl_squares_Q)){ // In between squares must be free
-                    if(!(cstl_traverse_Q&attacked_sq)){ // The squares that the king needs to pass must not be attacked
-                        move_list->move_stack[move_list->size++] = cstl_move_Q;
-                    }
-                    
-                }
-            }
-            if(pos.castling_rights&cstl_K){ 
-                if(!((~pos.piece_bitboards[no_piece])&cstl_squares_K)){
-                    if(!(cstl_traverse_K&attacked_sq)){
-                        move_list->move_stack[move_list->size++] = cstl_move_K;
-                    }
-                }
-            }
-        }
+    pawn_captures<side>(pos.pieces(pawn | side), targets, move_list);
+    // Handle en passant
+    en_passant_captures<side>(pos, move_list);
 
-    }
+    pawn_quiet<side>(pos.pieces(pawn | side), free_squares, move_list);
+
+    castling_moves<side>(pos, move_list, attack_info);
+}
+
+inline void generate_quiet(const Position& pos, MoveList* move_list, AttackInfo& attack_info){
+    if(pos.to_move) generate_quiet<black>(pos, move_list, attack_info);
+    else            generate_quiet<white>(pos, move_list, attack_info);
+}
+
+inline void generate_captures(const Position& pos, MoveList* move_list){
+    if(pos.to_move) generate_captures<black>(pos, move_list);
+    else            generate_captures<white>(pos, move_list);
+}
+
+inline void generate_quiet_checks(const Position& pos, MoveList* move_list, AttackInfo& attack_info){
+    if(pos.to_move) generate_quiet_checks<black>(pos, move_list, attack_info);
+    else            generate_quiet_checks<white>(pos, move_list, attack_info);
+}
+
+inline void generate_all(const Position& pos, MoveList* move_list, AttackInfo& attack_info){
+    if(pos.to_move) generate_all<black>(pos, move_list, attack_info);
+    else            generate_all<white>(pos, move_list, attack_info);
+}
+
+// For callers that do not keep an AttackInfo of the node
+inline void generate_quiet(const Position& pos, MoveList* move_list){
+    AttackInfo attack_info(pos);
+    generate_quiet(pos, move_list, attack_info);
+}
+
+inline void generate_all(const Position& pos, MoveList* move_list){
+    AttackInfo attack_info(pos);
+    generate_all(pos, move_list, attack_info);
 }
 
 #endif //MOVEGEN
\ No newline at end of file
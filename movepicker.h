@@ -10,6 +10,7 @@
 #include "movegen.h"
 
 enum GenerationState{
+    quiet_check_state = 3,
     capture_state = 2,
     quiet_state = 1,
     done_state = 0
@@ -70,13 +71,89 @@ std::array<uint8_t, 16> attacker_values ={
 
 
 
+// Piece values in centipawns for the static exchange evaluation, the king
+// can not be captured and ends an exchange
+constexpr std::array<int, 16> see_values = {
+    0, 100, 300, 300, 500, 900, 0, 0,
+    0, 100, 300, 300, 500, 900, 0, 0
+};
+
+// Static exchange evaluation: true if the move wins at least threshold
+// centipawns when both sides recapture on the target square with their
+// least valuable piece and may stop whenever that is better. Pins are
+// ignored. Castling, en passant and promotions count as an even trade.
+inline bool see_ge(const Position& pos, Move move, int threshold){
+    if((move&0xF000) >= 0x2000) return threshold <= 0;
+
+    Square from = from_square(move);
+    Square to = to_square(move);
+
+    // What is won if the piece is not recaptured
+    int swap = see_values[pos.board[to]] - threshold;
+    if(swap < 0) return false;
+
+    // What is still won if it is recaptured
+    swap = see_values[pos.board[from]] - swap;
+    if(swap <= 0) return true;
+
+    Bitboard occupied = pos.occupied() ^ (1ULL << from) ^ (1ULL << to);
+    Bitboard attackers = attackers_to(pos, to, occupied);
+    Bitboard bishops = pos.type_pieces(bishop) | pos.type_pieces(queen);
+    Bitboard rooks = pos.type_pieces(rook) | pos.type_pieces(queen);
+    PieceColor side = pos.board[from] & color_mask;
+
+    // 1 if the side that made the move wins, flipped with every capture
+    int result = 1;
+
+    while(true){
+        side ^= black;
+        attackers &= occupied;
+
+        Bitboard side_attackers = attackers & pos.color_pieces(side);
+        if(!side_attackers) break;
+
+        result ^= 1;
+
+        // Find the least valuable attacker, its value is what the other side can win next
+        Bitboard least_valuable = 0;
+        int p_type;
+        for(p_type = pawn; p_type < king; p_type++){
+            least_valuable = side_attackers & pos.type_pieces(PieceType(p_type));
+            if(least_valuable) break;
+        }
+
+        // Capturing with the king is only possible if no attacker is left
+        if(p_type == king){
+            return (attackers & pos.color_pieces(side ^ black)) ? result ^ 1 : result;
+        }
+
+        swap = see_values[p_type] - swap;
+        if(swap < result) break;
+
+        occupied ^= least_valuable & -least_valuable;
+
+        // Sliders behind the piece that just captured join in
+        if((p_type == pawn) || (p_type == bishop) || (p_type == queen)){
+            attackers |= get_bishop_attack_BB(to, occupied) & bishops;
+        }
+        if((p_type == rook) || (p_type == queen)){
+            attackers |= get_rook_attack_BB(to, occupied) & rooks;
+        }
+    }
+
+    return result;
+}
+
 class MovePicker{
     public:
-        MovePicker(const Position& chess_position) : 
-                    pos(chess_position),  
+        MovePicker(const Position& chess_position, AttackInfo& node_attack_info) : 
+                    index(0),
                     generation_state(capture_state),
                     quiescience(false),
-                    index(0) {}
+                    quiet_checks(false),
+                    tt_move(0),
+                    pos(chess_position),
+                    attack_info(node_attack_info) {}
 
         // Returns next move to be searched
         Move pick_next_move();
@@ -84,7 +161,11 @@ class MovePicker{
         // Add moves, for PV and TT move 
         void add_move(Move m);
 
-        void set_qs();
+        // Adds the move from the TT if it is pseudolegal in this position
+        void add_tt_move(Move m);
+
+        // Captures only, with with_checks the quiet checks follow them
+        void set_qs(bool with_checks = false);
 
     private:
         // Store moves in the move list
@@ -98,11 +179,20 @@ class MovePicker{
         // If in quiescience search, do not generate quiet moves
         bool quiescience;
 
+        // Generate quiet checking moves after the captures in QS
+        bool quiet_checks;
+
+        // Castling from the TT still has to be checked for attacked squares when picked
+        Move tt_move;
+
         //generates the next move stage
         void generate_next();
 
         const Position& pos;
 
+        // Attack sets of the node, shared with the search
+        AttackInfo& attack_info;
+
         // Sorting routines
         bool mvv_lva(Move x, Move y);
 
@@ -111,16 +201,23 @@ class MovePicker{
 
 
 Move MovePicker::pick_next_move(){
-    Move next_move = this->move_list.move_stack[index++];
-    // If next_move is a move, return it
-    if(next_move) return next_move;
-    else{ // If it is empty, generate more moves
+    Move next_move = this->move_list.move_stack[index];
+
+    // If it is empty, generate the next stages until there are moves or nothing is left
+    while(!next_move){
+        if(generation_state == done_state) return 0;
+
         this->generate_next();
+        next_move = this->move_list.move_stack[index];
+    }
+    index++;
 
-        // If there were no no moves generated, this returns 0
-        // Since the index was iterated, look at index - 1
-        return this->move_list.move_stack[index - 1];
+    if(next_move == tt_move){
+        // The TT move is always first, the generated copy of it is skipped
+        if(index > 1) return pick_next_move();
+        if((next_move&0x8000) && !attack_info.castling_path_safe(next_move)) return pick_next_move();
     }
+    return next_move;
 }
 
 void MovePicker::generate_next(){
@@ -140,7 +237,7 @@ void MovePicker::generate_next(){
                 );
 
         if(quiescience){ 
-            generation_state = done_state; 
+            generation_state = quiet_checks ? quiet_check_state : done_state; 
             break;}
 
         // If no moves were generated and not in QS, generate quiets
@@ -149,7 +246,12 @@ void MovePicker::generate_next(){
             }
 
     case quiet_state:
-        generate_quiet(pos, &move_list);
+        generate_quiet(pos, &move_list, attack_info);
+        generation_state = done_state;
+        break;
+
+    case quiet_check_state:
+        generate_quiet_checks(pos, &move_list, attack_info);
         generation_state = done_state;
         break;
     
@@ -162,7 +264,17 @@ void MovePicker::add_move(Move m){
     this->move_list.move_stack[this->move_list.size++] = m;
 }
 
-void MovePicker::set_qs(){quiescience = true;}
+void MovePicker::add_tt_move(Move m){
+    if(pos.is_pseudolegal(m)){
+        tt_move = m;
+        add_move(m);
+    }
+}
+
+void MovePicker::set_qs(bool with_checks){
+    quiescience = true;
+    quiet_checks = with_checks;
+}
 
 inline bool MovePicker::mvv_lva(Move x, Move y) 
 {   
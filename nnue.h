@@ -0,0 +1,310 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <array>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+#include "types.h"
+#include "utility.h"
+#include "position.h"
+#include "make_unmake.cpp"
+
+/*
+Optional neural network eval, built with make DEFINES=-DNNUE and used once
+a network is loaded from nnue_file. Without a network the normal eval is used.
+
+    Input       HalfKP: for each perspective the own king square times the
+                10 other pieces on 64 squares, 40960 features
+    Layer 1     40960 -> 256 for each perspective, int16. The outputs are
+                the accumulators in the position history
+    Layer 2     512 -> 32, int8 weights, the side to move comes first
+    Layer 3     32 -> 32, int8 weights
+    Output      32 -> 1, divided by nnue_output_scale to get centipawns
+
+Between the layers the values are clipped to 0-127, after layers 2 and 3
+they are shifted down by nnue_weight_shift first.
+
+Only the features of the pieces that moved change, so the accumulators are
+computed from the one before the move with a few additions and
+subtractions. This is done lazily in the eval, walking back through the
+history to the last computed accumulator. A king move changes all features
+of its perspective, that half is computed from scratch.
+
+The file starts with the sizes below as 32 bit integers and then has the
+weights and biases in the order of NnueWeights, little endian.
+*/
+
+constexpr int nnue_features = 64*640;
+constexpr int nnue_l2_size = 32;
+constexpr int nnue_l3_size = 32;
+
+constexpr int nnue_weight_shift = 6;
+constexpr int nnue_output_scale = 16;
+
+// The weights come from a file, so the output can be anything. The eval cache
+// keeps scores as int16 and the search expects them far below the mate scores
+constexpr int nnue_max_score = 30000;
+
+const std::string nnue_file = "ratio.nnue";
+
+struct alignas(64) NnueWeights{
+    std::array<std::array<int16_t, nnue_half_size>, nnue_features> feature_weights;
+    std::array<int16_t, nnue_half_size> feature_biases;
+    std::array<std::array<int8_t, 2*nnue_half_size>, nnue_l2_size> l2_weights;
+    std::array<int32_t, nnue_l2_size> l2_biases;
+    std::array<std::array<int8_t, nnue_l2_size>, nnue_l3_size> l3_weights;
+    std::array<int32_t, nnue_l3_size> l3_biases;
+    std::array<int8_t, nnue_l3_size> output_weights;
+    int32_t output_bias;
+};
+
+// 20 MB, almost all of it the first layer
+static NnueWeights nnue_weights;
+bool nnue_loaded = false;
+
+// Features that change with one move, at most 2 removed (captures) and 1 added
+struct FeatureDelta{
+    std::array<int, 2> removed;
+    std::array<int, 1> added;
+    int removed_count = 0;
+    int added_count = 0;
+};
+
+// The own pieces first, kings are not features
+inline int feature_index(int perspective, Square king_sq, Piece pce, Square sq){
+    Square orient = perspective ? 56 : 0;
+    int piece_index = 2*((pce&type_mask) - 1) + ((pce >> 3) != perspective);
+    return 640*(king_sq ^ orient) + 64*piece_index + (sq ^ orient);
+}
+
+// Features of the move in undo, seen from a perspective whose king did not move
+inline FeatureDelta feature_delta(int perspective, Square king_sq, const UndoObject& undo){
+    FeatureDelta delta;
+    Square from = from_square(undo.move);
+    Square to = to_square(undo.move);
+    Piece moved = undo.moved_piece;
+
+    auto removes = [&](Piece pce, Square sq){delta.removed[delta.removed_count++] = feature_index(perspective, king_sq, pce, sq);};
+    auto adds = [&](Piece pce, Square sq){delta.added[delta.added_count++] = feature_index(perspective, king_sq, pce, sq);};
+
+    if(undo.target_piece) removes(undo.target_piece, to);
+    if((moved&type_mask) != king) removes(moved, from);
+
+    switch(undo.move&0xF000){
+    case 0:
+    case 0x1000:
+        if((moved&type_mask) != king) adds(moved, to);
+        break;
+    case 0x2000:
+        // The pawn taken en passant is behind the target square
+        adds(moved, to);
+        if(moved&black) removes(w_pawn, to + 8);
+        else removes(b_pawn, to - 8);
+        break;
+    case 0x8000:{
+        Piece rook_pce = rook | (moved&black);
+        removes(rook_pce, cstl_rook_from[to]);
+        adds(rook_pce, cstl_rook_to[to]);
+        break;
+        }
+    default:
+        // PROMOTION, 0x3000 is a knight up to 0x6000 for a queen
+        adds(moved + ((undo.move >> 12) - 2), to);
+        break;
+    }
+    return delta;
+}
+
+// KERNELS:
+
+inline void add_feature(std::array<int16_t, nnue_half_size>& values, int feature){
+    const std::array<int16_t, nnue_half_size>& weights = nnue_weights.feature_weights[feature];
+#if defined(__AVX2__)
+    for(int i = 0; i < nnue_half_size; i += 16){
+        __m256i v = _mm256_load_si256((const __m256i*)&values[i]);
+        __m256i w = _mm256_load_si256((const __m256i*)&weights[i]);
+        _mm256_store_si256((__m256i*)&values[i], _mm256_add_epi16(v, w));
+    }
+#else
+    for(int i = 0; i < nnue_half_size; i++) values[i] += weights[i];
+#endif
+}
+
+inline void sub_feature(std::array<int16_t, nnue_half_size>& values, int feature){
+    const std::array<int16_t, nnue_half_size>& weights = nnue_weights.feature_weights[feature];
+#if defined(__AVX2__)
+    for(int i = 0; i < nnue_half_size; i += 16){
+        __m256i v = _mm256_load_si256((const __m256i*)&values[i]);
+        __m256i w = _mm256_load_si256((const __m256i*)&weights[i]);
+        _mm256_store_si256((__m256i*)&values[i], _mm256_sub_epi16(v, w));
+    }
+#else
+    for(int i = 0; i < nnue_half_size; i++) values[i] -= weights[i];
+#endif
+}
+
+// Clips int16 values to 0-127
+template <int size>
+inline void clip_accumulator(const int16_t* input, uint8_t* output){
+#if defined(__AVX2__)
+    for(int i = 0; i < size; i += 32){
+        __m256i a = _mm256_load_si256((const __m256i*)&input[i]);
+        __m256i b = _mm256_load_si256((const __m256i*)&input[i + 16]);
+        // packs saturates to -128-127 and mixes the 128 bit lanes, the permute puts them back
+        __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(a, b), _mm256_setzero_si256());
+        _mm256_store_si256((__m256i*)&output[i], _mm256_permute4x64_epi64(packed, 0b11011000));
+    }
+#else
+    for(int i = 0; i < size; i++) output[i] = std::clamp<int>(input[i], 0, 127);
+#endif
+}
+
+// Dot products of the clipped inputs with each row of int8 weights
+template <int in_size, int out_size>
+inline void affine(const uint8_t* input, const std::array<std::array<int8_t, in_size>, out_size>& weights,
+                   const std::array<int32_t, out_size>& biases, int32_t* output){
+    for(int o = 0; o < out_size; o++){
+#if defined(__AVX2__)
+        __m256i sum = _mm256_setzero_si256();
+        for(int i = 0; i < in_size; i += 32){
+            __m256i in = _mm256_load_si256((const __m256i*)&input[i]);
+            __m256i w = _mm256_loadu_si256((const __m256i*)&weights[o][i]);
+            // u8*i8 pairs added to int16, then pairs of those to int32
+            __m256i products = _mm256_maddubs_epi16(in, w);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(products, _mm256_set1_epi16(1)));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0b01001110));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0b10110001));
+        output[o] = biases[o] + _mm_cvtsi128_si32(half);
+#else
+        int32_t sum = biases[o];
+        for(int i = 0; i < in_size; i++) sum += input[i]*weights[o][i];
+        output[o] = sum;
+#endif
+    }
+}
+
+template <int size>
+inline void clip_layer(const int32_t* input, uint8_t* output){
+    for(int i = 0; i < size; i++) output[i] = std::clamp(input[i] >> nnue_weight_shift, 0, 127);
+}
+
+// ACCUMULATORS:
+
+inline void refresh_accumulator(Position& pos, int perspective, Accumulator& acc){
+    Square king_sq = get_lsb(pos.pieces(king | (perspective << 3))) - 1;
+
+    acc.values[perspective] = nnue_weights.feature_biases;
+    for(Bitboard pieces = pos.occupied() & ~pos.type_pieces(king); pieces; pieces &= pieces - 1){
+        Square sq = get_lsb(pieces) - 1;
+        add_feature(acc.values[perspective], feature_index(perspective, king_sq, pos.board[sq], sq));
+    }
+    acc.key[perspective] = pos.position_key;
+}
+
+// Position key before the move at index i of the history, or the current one
+inline uint64_t history_key(const Position& pos, int i){
+    return (i == pos.history.size) ? pos.position_key : pos.history.entries[i].position_key;
+}
+
+inline void update_accumulator(Position& pos, int perspective){
+    HistoryStack& history = pos.history;
+    Piece own_king = king | (perspective << 3);
+
+    if(history.accumulators[history.size].key[perspective] == pos.position_key) return;
+
+    // Walk back to a computed accumulator, unless the own king moved on the way
+    int start = history.size;
+    while(start > history.accumulator_base){
+        if(history.entries[start - 1].moved_piece == own_king) break;
+        start--;
+        if(history.accumulators[start].key[perspective] == history_key(pos, start)) break;
+    }
+
+    if((start == history.size) || (history.accumulators[start].key[perspective] != history_key(pos, start))){
+        refresh_accumulator(pos, perspective, history.accumulators[history.size]);
+        return;
+    }
+
+    Square king_sq = get_lsb(pos.pieces(own_king)) - 1;
+    for(int i = start; i < history.size; i++){
+        FeatureDelta delta = feature_delta(perspective, king_sq, history.entries[i]);
+        std::array<int16_t, nnue_half_size>& values = history.accumulators[i + 1].values[perspective];
+
+        values = history.accumulators[i].values[perspective];
+        for(int j = 0; j < delta.removed_count; j++) sub_feature(values, delta.removed[j]);
+        for(int j = 0; j < delta.added_count; j++) add_feature(values, delta.added[j]);
+        history.accumulators[i + 1].key[perspective] = history_key(pos, i + 1);
+    }
+}
+
+// Score for the side to move in centipawns
+inline int nnue_evaluate(Position& pos){
+    int us = pos.to_move >> 3;
+
+    update_accumulator(pos, 0);
+    update_accumulator(pos, 1);
+    const Accumulator& acc = pos.history.accumulators[pos.history.size];
+
+    alignas(64) std::array<uint8_t, 2*nnue_half_size> l1_out;
+    alignas(64) std::array<int32_t, nnue_l2_size> l2_sums;
+    alignas(64) std::array<uint8_t, nnue_l2_size> l2_out;
+    alignas(64) std::array<int32_t, nnue_l3_size> l3_sums;
+    alignas(64) std::array<uint8_t, nnue_l3_size> l3_out;
+
+    clip_accumulator<nnue_half_size>(acc.values[us].data(), l1_out.data());
+    clip_accumulator<nnue_half_size>(acc.values[us ^ 1].data(), l1_out.data() + nnue_half_size);
+
+    affine<2*nnue_half_size, nnue_l2_size>(l1_out.data(), nnue_weights.l2_weights, nnue_weights.l2_biases, l2_sums.data());
+    clip_layer<nnue_l2_size>(l2_sums.data(), l2_out.data());
+
+    affine<nnue_l2_size, nnue_l3_size>(l2_out.data(), nnue_weights.l3_weights, nnue_weights.l3_biases, l3_sums.data());
+    clip_layer<nnue_l3_size>(l3_sums.data(), l3_out.data());
+
+    int32_t output = nnue_weights.output_bias;
+    for(int i = 0; i < nnue_l3_size; i++) output += l3_out[i]*nnue_weights.output_weights[i];
+
+    return std::clamp(output/nnue_output_scale, -nnue_max_score, nnue_max_score);
+}
+
+// Returns false and keeps the normal eval if the file is missing or has other sizes
+bool load_nnue(const std::string& path){
+    std::ifstream in(path, std::ios::binary);
+    if(!in) return false;
+
+    std::array<int32_t, 4> sizes;
+    constexpr std::array<int32_t, 4> expected = {nnue_features, nnue_half_size, nnue_l2_size, nnue_l3_size};
+    in.read(reinterpret_cast<char*>(sizes.data()), sizeof(sizes));
+    if(!in || (sizes != expected)){
+        std::cout << "NNUE: " << path << " does not match the network sizes" << std::endl;
+        return false;
+    }
+
+    auto read = [&](auto& data){in.read(reinterpret_cast<char*>(&data), sizeof(data));};
+    read(nnue_weights.feature_weights);
+    read(nnue_weights.feature_biases);
+    read(nnue_weights.l2_weights);
+    read(nnue_weights.l2_biases);
+    read(nnue_weights.l3_weights);
+    read(nnue_weights.l3_biases);
+    read(nnue_weights.output_weights);
+    read(nnue_weights.output_bias);
+
+    if(!in){
+        std::cout << "NNUE: " << path << " is too short" << std::endl;
+        return false;
+    }
+
+    std::cout << "NNUE: loaded " << path << std::endl;
+    return true;
+}
+
+#endif // NNUE_H
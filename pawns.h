@@ -0,0 +1,107 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include <array>
+
+#include "types.h"
+#include "utility.h"
+#include "bitboard.h"
+#include "position.h"
+
+/*
+Pawn structure evaluation: doubled, isolated, backward and passed pawns.
+It only depends on the pawns, so the result is kept in a small table
+indexed by the pawn key of the position. The same pawn structures come up
+over and over in a search, so most evals only cost one probe of a table
+that stays in the cache.
+*/
+
+// Scores in centipawns, opening and endgame
+constexpr int doubled_opening   = 10;
+constexpr int doubled_endgame   = 20;
+constexpr int isolated_opening  = 10;
+constexpr int isolated_endgame  = 15;
+constexpr int backward_opening  = 8;
+constexpr int backward_endgame  = 10;
+
+// Indexed by the rank seen from the pawn's color
+constexpr std::array<int, 8> passed_opening = {0, 5, 5, 10, 20, 35, 60, 0};
+constexpr std::array<int, 8> passed_endgame = {0, 10, 15, 25, 45, 75, 120, 0};
+
+// Score of a pawn structure from white's point of view
+struct PawnEntry{
+    uint64_t key;
+    int16_t opening;
+    int16_t endgame;
+};
+
+// 4096 entries of 16 bytes, 64 KB
+constexpr short pawn_tbl_idx_len = 12;
+constexpr unsigned long pawn_tbl_size = 1UL << pawn_tbl_idx_len;
+
+// A position without pawns has key 0, so the empty entries are right for it
+static std::array<PawnEntry, pawn_tbl_size> pawn_table;
+
+unsigned long long pawn_table_probes;
+unsigned long long pawn_table_hits;
+
+template <PieceColor side>
+inline void evaluate_pawns(const Position& pos, int& opening, int& endgame){
+    constexpr int color = side >> 3;
+    constexpr int sign = (side == white) ? 1 : -1;
+
+    Bitboard own_pawns = pos.pieces(pawn | side);
+    Bitboard enemy_pawns = pos.pieces(pawn | opponent<side>);
+    Bitboard enemy_attacks = pawn_attacks<opponent<side>>(enemy_pawns);
+
+    for(Bitboard pawns = own_pawns; pawns; pawns &= pawns - 1){
+        Square sq = get_lsb(pawns) - 1;
+        Square stop = sq + pawn_push_offset<side>;
+        int file = sq%8;
+        int rank = (side == white) ? sq/8 : 7 - sq/8;
+
+        // Only the pawn in front counts as passed, the ones behind it are doubled
+        bool doubled = front_span[color][sq] & own_pawns;
+
+        if(doubled){
+            opening -= sign*doubled_opening;
+            endgame -= sign*doubled_endgame;
+        }
+
+        if(!(adjacent_files[file] & own_pawns)){
+            opening -= sign*isolated_opening;
+            endgame -= sign*isolated_endgame;
+        }
+        // No pawn next to or behind it on the adjacent files can support
+        // it and an enemy pawn keeps it from advancing
+        else if(!(passed_pawn_mask[color ^ 1][stop] & adjacent_files[file] & own_pawns)
+                && (enemy_attacks & (1ULL << stop))){
+            opening -= sign*backward_opening;
+            endgame -= sign*backward_endgame;
+        }
+
+        if(!doubled && !(passed_pawn_mask[color][sq] & enemy_pawns)){
+            opening += sign*passed_opening[rank];
+            endgame += sign*passed_endgame[rank];
+        }
+    }
+}
+
+inline const PawnEntry& probe_pawn_table(const Position& pos){
+    PawnEntry& entry = pawn_table[pos.pawn_key & (pawn_tbl_size - 1)];
+
+    pawn_table_probes++;
+    if(entry.key == pos.pawn_key){
+        pawn_table_hits++;
+        return entry;
+    }
+
+    int opening = 0, endgame = 0;
+    evaluate_pawns<white>(pos, opening, endgame);
+    evaluate_pawns<black>(pos, opening, endgame);
+
+    entry = PawnEntry{pos.pawn_key, static_cast<int16_t>(opening), static_cast<int16_t>(endgame)};
+    return entry;
+}
+
+#endif // PAWNS_H
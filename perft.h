@@ -197,7 +197,7 @@ unsigned long long do_perft(int depth, Position& pos, bool divide){
 
 unsigned long long perft(int depth, Position& pos){
 
-    if(get_checkers(black - pos.to_move, pos)){
+    if(in_check(black - pos.to_move, pos)){
         return 0;
     }
 
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <string>
 #include <array>
+#include <thread>
 
 #include "types.h"
 #include "position.h"
@@ -17,6 +18,55 @@
 
 Move parse_input_move(std::string input_move);
 
+/*
+While the human thinks, the engine can ponder: it plays the reply it
+expects from the PV of its last search and searches the position after it
+on a second thread. If the human plays that move, the search goes on as the
+search for the next engine move. Otherwise it is stopped, its table entries
+are kept for the search of the real move. The ponder search starts with the
+table of the engine search before it as well.
+*/
+struct Ponder{
+    std::thread thread;
+    Move expected_move = 0;
+    Move result = 0;
+    bool hit = false;
+
+    bool running(){return thread.joinable();}
+
+    void start(const Position& game_pos, int depth){
+        // The search only knows the PV of its root
+        if(pv_length[0] < 2) return;
+
+        expected_move = principal_variation[1];
+        hit = false;
+
+        // The search copies the position when it starts, so it needs one of its own
+        static Position ponder_pos;
+        ponder_pos.copy_from(game_pos);
+        make_move(ponder_pos, expected_move);
+
+        // The table of the search that just ended is good for the position after its PV
+        pondering = true;
+        thread = std::thread([this, depth](){result = search_position(ponder_pos, depth, 1, true);});
+    }
+
+    // The search was ahead of the game, the search of the engine move takes its place
+    Move finish(){
+        thread.join();
+        hit = false;
+        return result;
+    }
+
+    void stop(){
+        stop_search = true;
+        thread.join();
+        stop_search = false;
+        pondering = false;
+        hit = false;
+    }
+};
+
 void start_game(){
     Position pos;
     std::string fen_str;
@@ -44,26 +94,39 @@ void start_game(){
     int depth;
     std::cout << "Search depth: " << std::endl;
     std::cin >> depth;
+
+    std::string ponder_answer;
+    std::cout << "Ponder on the opponent's time (y/n): " << std::endl;
+    std::cin >> ponder_answer;
+    bool ponder_enabled = (ponder_answer == "y");
     
     std::string dummy;
     std::getline(std::cin , dummy);
 
+    Ponder ponder;
+
+    // After a ponder miss the table of the stopped search is still good
+    bool keep_table = false;
+
 
 
     while(true){
 
         engine_move = false;
         player_move = 0;
+        Move played_move = 0;
+        bool undone = false;
         std::string move_string;
         std::cout << "Move to play (0 to reverse, 1 for computer): " << std::endl;
-        std::getline(std::cin , move_string);
+        if(!std::getline(std::cin , move_string)) break;
 
 
         if(move_string.length() > 5) std::cout << "Input too long!" << std::endl;
         else if(move_string == "0"){
-            if(pos.total_move_count){
+            if(pos.move_count()){
                 unmake_move(pos);
                 print_position(pos);
+                undone = true;
             }
             else std::cout << "No move to undo!" << std::endl;
         }
@@ -132,21 +195,67 @@ void start_game(){
                             break;
                         }
                         print_position(pos);
+                        played_move = move;
                         // move_made = true;
                 }
             }
         }
 
+        if(ponder.running()){
+            if(played_move && (played_move == ponder.expected_move) && !ponder.hit){
+                // The search now runs for the engine move and shows its iterations
+                std::cout << "Ponder hit" << std::endl;
+                ponder.hit = true;
+                pondering = false;
+            }
+            else if(played_move || undone || (engine_move && !ponder.hit)){
+                // Only a different move of the opponent leaves the same positions in the game
+                keep_table = played_move && !ponder.hit;
+                ponder.stop();
+            }
+        }
+        else if(played_move || undone) keep_table = false;
+
         // Do computer move
         if(engine_move){
             std::cout << "Computer is thinking..." << std::endl;
-            computer_move = search_position(pos, depth);
+            if(ponder.running()) computer_move = ponder.finish();
+            else computer_move = search_position(pos, depth, 1, keep_table);
+            keep_table = false;
 
             make_move(pos, computer_move);
             print_position(pos);
 
+            if(ponder_enabled) ponder.start(pos, depth);
         }
     }
+
+    if(ponder.running()) ponder.stop();
+}
+
+// Searches a position and shows the best lines instead of playing a move
+void start_analysis(){
+    Position pos;
+    std::string fen_str;
+
+    std::cout << "Position FEN (0 for initial position): " << std::endl;
+    std::getline(std::cin, fen_str);
+    if(fen_str.length() >  10){
+        read_from_fen(fen_str, pos);
+        }
+    else{
+        read_from_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 ", pos);
+    }
+
+    print_position(pos);
+
+    int depth, lines;
+    std::cout << "Search depth: " << std::endl;
+    std::cin >> depth;
+    std::cout << "Number of lines: " << std::endl;
+    std::cin >> lines;
+
+    search_position(pos, depth, std::max(lines, 1));
 }
 
 Move parse_input_move(std::string input_move){
@@ -14,6 +14,7 @@
 #include "types.h"
 #include "utility.h"
 #include "bitboard.h"
+#include "position_tables.h"
 
 
 // Calculate how many random values are needed for the Zobrist hash
@@ -35,6 +36,20 @@ enum RandTableIndices{
     cstl_q_rnd_id = 64*num_types + 4
 };
 
+// Added to the material key for a piece, 0 for the empty square and the unused codes
+static constexpr auto material_key_delta{[]() constexpr{
+    std::array<uint64_t, 16> result{};
+    for(Piece pce : {w_pawn, w_knight, w_bishop, w_rook, w_queen, w_king,
+                     b_pawn, b_knight, b_bishop, b_rook, b_queen, b_king}){
+        result[pce] = 1ULL << (4*pce);
+    }
+    return result;
+}()};
+
+// Number of pieces of one kind, e.g. piece_count(pos.material_key, w_knight)
+constexpr int piece_count(uint64_t material_key, Piece pce){
+    return (material_key >> (4*pce)) & 0xF;
+}
 
 // When running the program, put random numbers in this array
 auto rnd_value_array{[]() {
@@ -68,29 +83,110 @@ auto rnd_value_array{[]() {
     return result;
 }()};
 
-class Position{
+/*
+BoardState holds everything that is needed to describe the board and is
+touched on every move. It is kept small (about 150 bytes) so it can be
+copied cheaply and stays in a few cache lines.
+
+type_bitboards[t - 1] holds all pieces of PieceType t of both colors,
+color_bitboards[0] all white and color_bitboards[1] all black pieces.
+Free squares and single piece boards are derived from those.
+
+The mailbox board uses the same enums (color | type) as types.h.
+
+Building with -DATTACK_COUNTS also keeps the number of attackers of every
+square for both colors, updated in make_move. The counts are bit-sliced:
+plane i holds bit i of the count of every square.
+*/
+#ifdef ATTACK_COUNTS
+constexpr int attack_count_planes = 5; // Up to 31 attackers of one square
+
+typedef std::array<Bitboard, attack_count_planes> AttackPlanes;
+#endif
+
+#ifdef NNUE
+constexpr int nnue_half_size = 256; // Neurons of the first layer for each perspective
+
+// First layer of the network for both perspectives, indexed by color >> 3.
+// Each half is marked with the key of the position it was computed for.
+struct alignas(64) Accumulator{
+    std::array<std::array<int16_t, nnue_half_size>, 2> values;
+    std::array<uint64_t, 2> key;
+};
+#endif
+
+struct BoardState{
+    std::array<Bitboard, 6> type_bitboards;
+    std::array<Bitboard, 2> color_bitboards;
+
+    std::array<Piece, 64> board;
+
+    uint64_t position_key;
+    // Key of the pawns only, made from their entries in rnd_value_array
+    uint64_t pawn_key;
+    // Number of pieces of every kind, 4 bits for each at 4*piece
+    uint64_t material_key;
+
+    // Sums of the opening and endgame piece square tables, white minus black
+    int16_t psqt_opening;
+    int16_t psqt_endgame;
+
+    Square en_passant;
+    
+    uint8_t to_move;
+    uint8_t castling_rights;
+    uint8_t halfmove_clock;
+
+#ifdef ATTACK_COUNTS
+    // Indexed by color >> 3
+    std::array<AttackPlanes, 2> attack_planes;
+#endif
+
+    // Pieces of one type and color, e.g. pieces(w_knight) or pieces(knight | side)
+    inline Bitboard pieces(Piece pce) const {
+        return type_bitboards[(pce&type_mask) - 1] & color_bitboards[pce >> 3];
+    }
+    // Pieces of one type of both colors
+    inline Bitboard type_pieces(PieceType p_type) const {return type_bitboards[p_type - 1];}
+    // All pieces of white (0) or black (8)
+    inline Bitboard color_pieces(uint8_t color) const {return color_bitboards[color >> 3];}
+
+    inline Bitboard occupied() const {return color_bitboards[0] | color_bitboards[1];}
+    inline Bitboard free_squares() const {return ~occupied();}
+};
+
+// Stack of undo information for every move played so far. The keys are
+// also used for repetitions, so the whole game is kept here.
+struct HistoryStack{
+    std::array<UndoObject, max_game_length> entries;
+#ifdef ATTACK_COUNTS
+    // Counts before each move, so unmake does not have to update them
+    std::array<std::array<AttackPlanes, 2>, max_game_length> attack_planes;
+#endif
+#ifdef NNUE
+    // Accumulator of the position before each move and of the current one,
+    // computed lazily by the eval from the moves in entries
+    std::array<Accumulator, max_game_length + 1> accumulators;
+    // The moves before this index do not lead to the position, it was set up
+    uint16_t accumulator_base;
+#endif
+    uint16_t size;
+};
+
+class Position : public BoardState{
     public:
         Position(){
-            piece_bitboards = {0ULL};
-            piece_bitboards[no_piece]   = 0x0000FFFFFFFF0000ULL;
-
-            piece_bitboards[w_pawn]     = __2_RANK;
-            piece_bitboards[w_knight]   = 0x0000000000000042ULL; 
-            piece_bitboards[w_king]     = 0x0000000000000010ULL;
-            piece_bitboards[w_bishop]   = 0x0000000000000024ULL;
-            piece_bitboards[w_rook]     = 0x0000000000000081ULL;
-            piece_bitboards[w_queen]    = 0x0000000000000008ULL;
-            piece_bitboards[w_piece]    = 0x000000000000FFFFULL;
-
-            piece_bitboards[dummy]      = 0x0ULL;
-
-            piece_bitboards[b_pawn]     = __7_RANK;
-            piece_bitboards[b_knight]   = 0x4200000000000000ULL;
-            piece_bitboards[b_king]     = 0x1000000000000000ULL;
-            piece_bitboards[b_bishop]   = 0x2400000000000000ULL;
-            piece_bitboards[b_rook]     = 0x8100000000000000ULL;
-            piece_bitboards[b_queen]    = 0x0800000000000000ULL;
-            piece_bitboards[b_piece]    = 0xFFFF000000000000ULL;
+            type_bitboards = {0ULL};
+
+            type_bitboards[pawn - 1]    = __2_RANK | __7_RANK;
+            type_bitboards[knight - 1]  = 0x4200000000000042ULL; 
+            type_bitboards[bishop - 1]  = 0x2400000000000024ULL;
+            type_bitboards[rook - 1]    = 0x8100000000000081ULL;
+            type_bitboards[queen - 1]   = 0x0800000000000008ULL;
+            type_bitboards[king - 1]    = 0x1000000000000010ULL;
+
+            color_bitboards[0]          = 0x000000000000FFFFULL;
+            color_bitboards[1]          = 0xFFFF000000000000ULL;
 
             en_passant = 0;
 
@@ -110,67 +206,66 @@ class Position{
 
             halfmove_clock = 0;
 
-            position_history = {UndoObject()};
-            total_move_count = 0;
+            history.entries = {UndoObject()};
+            history.size = 0;
+#ifdef NNUE
+            for(Accumulator& acc : history.accumulators) acc.key = {0ULL, 0ULL};
+#endif
 
             // Initialize the position key
             init_position_key();
-            
+#ifdef ATTACK_COUNTS
+            init_attack_counts();
+#endif
         }
-        /*
-        Position bitboards correspond to the enum Piece numbers 
-        in types.h, so no_piece = 0 is all empty squares,
-        w_pawn = 1 all squares with pawns etc.
-
-        Position board is a mailbox representation, and the same
-        enums that index the bitboards represent pieces in the pos_board
-
-        */
-        std::array<Bitboard, 16> piece_bitboards;
 
-        std::array<Piece, 64> board;
+        // Cold data, only touched once per make/unmake
+        HistoryStack history;
 
-        //std::array<uint64_t, __
+#ifdef COPY_MAKE
+        std::array<BoardState, max_game_length> snapshot_history;
 
-        Square en_passant;
-        
-        uint8_t to_move;
-        uint8_t castling_rights;
-        uint8_t halfmove_clock;
-
-        uint64_t position_key;
-
-        std::array<UndoObject, max_game_length> position_history;
-        uint16_t total_move_count;
+        void push_snapshot();
+        void pop_snapshot();
+#endif
 
         void init_position_key();
+#ifdef ATTACK_COUNTS
+        void init_attack_counts();
+#endif
 
-        bool is_pseudolegal(Move move);
+        bool is_pseudolegal(Move move) const;
 
         void push_history(Piece moved, Piece target, Move move);
         UndoObject get_last_history();
         UndoObject pop_history();
 
+        uint16_t move_count() const {return history.size;}
+
         bool is_repetition();
 
+        // Copies the board and only the used part of the history
+        void copy_from(const Position& other);
+
 };
 
 void Position::init_position_key(){
-    Bitboard pieces = 0ULL;
-    Square sq = 0;
-
     // Start with a zero key
     this->position_key = 0ULL;
-
-    // First hash in the Piece Bitboards and empty squares
-    for(int index; index < num_types; index++){
-        if((index == w_piece) || (index == b_piece)) continue;
-        pieces = this->piece_bitboards[index];
-        while(pieces){
-            sq = get_lsb(pieces) - 1;
-            this->position_key ^= rnd_value_array[64*index + sq];
-            pieces &= pieces - 1;
-        }
+    this->pawn_key = 0ULL;
+    this->material_key = 0ULL;
+    this->psqt_opening = 0;
+    this->psqt_endgame = 0;
+
+    // First hash in the pieces
+    for(int sq = 0; sq < 64; sq++){
+        if(board[sq]) this->position_key ^= rnd_value_array[64*board[sq] + sq];
+        if((board[sq]&type_mask) == pawn) this->pawn_key ^= rnd_value_array[64*board[sq] + sq];
+        this->material_key += material_key_delta[board[sq]];
+
+        int sign = (board[sq]&black) ? -1 : 1;
+        this->psqt_opening += sign*piece_square_tbl_opening[64*board[sq] + sq];
+        this->psqt_endgame += sign*piece_square_tbl_endgame[64*board[sq] + sq];
     }
 
     // Now hash in en passant square if there is one
@@ -185,6 +280,29 @@ void Position::init_position_key(){
     if(this->castling_rights&cstl_k) this->position_key ^= rnd_value_array[cstl_k_rnd_id];
     if(this->castling_rights&cstl_q) this->position_key ^= rnd_value_array[cstl_q_rnd_id];
 
+#ifdef NNUE
+    history.accumulator_base = history.size;
+#endif
+}
+
+inline void Position::copy_from(const Position& other){
+    static_cast<BoardState&>(*this) = other;
+    history.size = other.history.size;
+    std::copy_n(other.history.entries.begin(), other.history.size, history.entries.begin());
+#ifdef ATTACK_COUNTS
+    std::copy_n(other.history.attack_planes.begin(), other.history.size, history.attack_planes.begin());
+#endif
+#ifdef NNUE
+    // The accumulators are not copied, the first eval computes them again
+    history.accumulator_base = history.size;
+#endif
+}
+
+// Puts a piece on an empty square, used when setting up a position
+inline void add_piece(Position& pos, Square sq, Piece pce){
+    pos.type_bitboards[(pce&type_mask) - 1] |= 1ULL << sq;
+    pos.color_bitboards[pce >> 3] |= 1ULL << sq;
+    pos.board[sq] = pce;
 }
 
 
@@ -213,7 +331,8 @@ std::string read_from_fen(std::string fen, Position& pos){
     std::string remaining_string = "";
 
     // Clear the whole position
-    pos.piece_bitboards = {0};
+    pos.type_bitboards = {0};
+    pos.color_bitboards = {0};
     pos.board = {no_piece};
     pos.en_passant = 0;
     pos.to_move = 0;
@@ -229,75 +348,51 @@ std::string read_from_fen(std::string fen, Position& pos){
             //first arrange the board
             switch(c){
                 case 'P':
-                    pos.piece_bitboards[w_pawn] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[w_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = w_pawn;
+                    add_piece(pos, square_id + 8*row_id, w_pawn);
                     square_id++;
                     break;
                 case 'N':
-                    pos.piece_bitboards[w_knight] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[w_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = w_knight;
+                    add_piece(pos, square_id + 8*row_id, w_knight);
                     square_id++;
                     break;
                 case 'K':
-                    pos.piece_bitboards[w_king] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[w_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = w_king;
+                    add_piece(pos, square_id + 8*row_id, w_king);
                     square_id++;
                     break;
                 case 'B':
-                    pos.piece_bitboards[w_bishop] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[w_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = w_bishop;
+                    add_piece(pos, square_id + 8*row_id, w_bishop);
                     square_id++;
                     break;
                 case 'R':
-                    pos.piece_bitboards[w_rook] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[w_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = w_rook;
+                    add_piece(pos, square_id + 8*row_id, w_rook);
                     square_id++;
                     break;
                 case 'Q':
-                    pos.piece_bitboards[w_queen] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[w_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = w_queen;
+                    add_piece(pos, square_id + 8*row_id, w_queen);
                     square_id++;
                     break;
                 case 'p':
-                    pos.piece_bitboards[b_pawn] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[b_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = b_pawn;
+                    add_piece(pos, square_id + 8*row_id, b_pawn);
                     square_id++;
                     break;
                 case 'n':
-                    pos.piece_bitboards[b_knight] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[b_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = b_knight;
+                    add_piece(pos, square_id + 8*row_id, b_knight);
                     square_id++;
                     break;
                 case 'k':
-                    pos.piece_bitboards[b_king] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[b_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = b_king;
+                    add_piece(pos, square_id + 8*row_id, b_king);
                     square_id++;
                     break;
                 case 'b':
-                    pos.piece_bitboards[b_bishop] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[b_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = b_bishop;
+                    add_piece(pos, square_id + 8*row_id, b_bishop);
                     square_id++;
                     break;
                 case 'r':
-                    pos.piece_bitboards[b_rook] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[b_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = b_rook;
+                    add_piece(pos, square_id + 8*row_id, b_rook);
                     square_id++;
                     break;
                 case 'q':
-                    pos.piece_bitboards[b_queen] |= 1ULL << (square_id + 8*row_id);
-                    pos.piece_bitboards[b_piece] |= 1ULL << (square_id + 8*row_id);
-                    pos.board[(square_id + 8*row_id)] = b_queen;
+                    add_piece(pos, square_id + 8*row_id, b_queen);
                     square_id++;
                     break;
                 case '/':
@@ -391,9 +486,10 @@ std::string read_from_fen(std::string fen, Position& pos){
         }
     }
 
-    // Calculate new occuopancy
-    pos.piece_bitboards[no_piece] = ~(pos.piece_bitboards[w_piece] | pos.piece_bitboards[b_piece]);
     pos.init_position_key();
+#ifdef ATTACK_COUNTS
+    pos.init_attack_counts();
+#endif
     return remaining_string;
 }
 
@@ -436,384 +532,560 @@ std::string output_fen(const Position& pos){
 
 
 
-// INFORMATION BITBOARDS
-// Returns squares attacked by this color
-inline Bitboard attacked_squares(uint_fast8_t color, const Position& pos){
-    
-    Bitboard attacked_sq = 0ULL;
-    Bitboard pieces = pos.piece_bitboards[knight | color];
-    Square sq = 0;
+#ifdef ATTACK_COUNTS
+// ATTACK COUNTS
 
+// Squares attacked by a piece standing on sq
+inline Bitboard piece_attacks(Piece pce, Square sq, Bitboard occupied){
+    switch (pce & type_mask)
+    {
+    case pawn:
+        return (pce & black) ? pawn_attacks<black>(1ULL << sq) : pawn_attacks<white>(1ULL << sq);
+    case knight:
+        return knight_attacks[sq];
+    case bishop:
+        return get_bishop_attack_BB(sq, occupied);
+    case rook:
+        return get_rook_attack_BB(sq, occupied);
+    case queen:
+        return get_bishop_attack_BB(sq, occupied) | get_rook_attack_BB(sq, occupied);
+    case king:
+        return king_attacks[sq];
+    default:
+        return 0ULL;
+    }
+}
 
-    while(pieces){
-        sq = get_lsb(pieces) - 1;
-        pieces &= pieces - 1;
+// Adds one to the count of every square on the board, ripple carry through the planes
+inline void increment_counts(AttackPlanes& planes, Bitboard squares){
+    for(Bitboard& plane : planes){
+        Bitboard carry = plane & squares;
+        plane ^= squares;
+        squares = carry;
+    }
+}
 
-        attacked_sq |= knight_attacks[sq];
+inline void decrement_counts(AttackPlanes& planes, Bitboard squares){
+    for(Bitboard& plane : planes){
+        Bitboard borrow = ~plane & squares;
+        plane ^= squares;
+        squares = borrow;
     }
+}
 
-    pieces = pos.piece_bitboards[king | color];
-    sq = 0;
+// Adds or removes the attacks of all pieces on the given squares
+template <bool add>
+inline void update_attack_counts(BoardState& pos, Bitboard pieces){
+    Bitboard occupied = pos.occupied();
 
     while(pieces){
-        sq = get_lsb(pieces) - 1;
-        pieces &= pieces - 1;
-
-        attacked_sq |= king_attacks[sq];
-    }
+        Square sq = get_lsb(pieces) - 1;
+        Piece pce = pos.board[sq];
 
-    pieces = pos.piece_bitboards[bishop | color]|pos.piece_bitboards[queen | color];
-    sq = 0;
+        if constexpr (add) increment_counts(pos.attack_planes[pce >> 3], piece_attacks(pce, sq, occupied));
+        else               decrement_counts(pos.attack_planes[pce >> 3], piece_attacks(pce, sq, occupied));
 
-    while(pieces){
-        sq = get_lsb(pieces) - 1;
         pieces &= pieces - 1;
-
-        attacked_sq |= get_bishop_attack_BB(sq, ~pos.piece_bitboards[no_piece]);
     }
+}
 
-    pieces = pos.piece_bitboards[rook | color]|pos.piece_bitboards[queen | color];
-    sq = 0;
+// Sliders of both colors that see one of the squares. Only their attacks
+// change when the occupancy of those squares changes
+inline Bitboard sliders_seeing(const BoardState& pos, Bitboard squares){
+    Bitboard occupied = pos.occupied();
+    Bitboard rooks = pos.type_pieces(rook) | pos.type_pieces(queen);
+    Bitboard bishops = pos.type_pieces(bishop) | pos.type_pieces(queen);
+    Bitboard result = 0ULL;
+
+    while(squares){
+        Square sq = get_lsb(squares) - 1;
+        result |= (get_rook_attack_BB(sq, occupied) & rooks) | (get_bishop_attack_BB(sq, occupied) & bishops);
+        squares &= squares - 1;
+    }
+    return result;
+}
 
-    while(pieces){
-        sq = get_lsb(pieces) - 1;
-        pieces &= pieces - 1;
+// All squares attacked at least once by the color
+inline Bitboard attack_map(const BoardState& pos, PieceColor color){
+    Bitboard result = 0ULL;
+    for(Bitboard plane : pos.attack_planes[color >> 3]) result |= plane;
+    return result;
+}
 
-        attacked_sq |= get_rook_attack_BB(sq, ~pos.piece_bitboards[no_piece]);
+// Number of attackers of the color on a square
+inline int attack_count(const BoardState& pos, PieceColor color, Square sq){
+    int result = 0;
+    for(int i = 0; i < attack_count_planes; i++){
+        result |= ((pos.attack_planes[color >> 3][i] >> sq) & 1) << i;
     }
+    return result;
+}
+
+void Position::init_attack_counts(){
+    attack_planes = {};
+    update_attack_counts<true>(*this, occupied());
+}
+#endif
 
 
-    if(color){
-        attacked_sq |= pawn_south_east(pos.piece_bitboards[b_pawn]);
-        attacked_sq |= pawn_south_west(pos.piece_bitboards[b_pawn]);
+// INFORMATION BITBOARDS
+// These are specialized on the color, the untemplated versions
+// below pick the specialization at runtime
+
+// Returns squares attacked by this color, all pieces of a type at once
+template <PieceColor side>
+inline Bitboard attacked_squares(const Position& pos){
+#ifdef ATTACK_COUNTS
+    return attack_map(pos, side);
+#else
+    Bitboard queens = pos.pieces(queen | side);
+    Bitboard attacked_sq = knight_attack_map(pos.pieces(knight | side))
+                           | king_attack_map(pos.pieces(king | side))
+                           | pawn_attacks<side>(pos.pieces(pawn | side));
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+    attacked_sq |= slider_attack_map(pos.pieces(rook | side) | queens,
+                                     pos.pieces(bishop | side) | queens,
+                                     pos.free_squares());
+#else
+    // Without vectors the fills are slower than one lookup per slider
+    Bitboard pieces;
+
+    for(pieces = pos.pieces(bishop | side) | queens; pieces; pieces &= pieces - 1){
+        attacked_sq |= get_bishop_attack_BB(get_lsb(pieces) - 1, pos.occupied());
     }
-    else{
-        attacked_sq |= pawn_north_east(pos.piece_bitboards[w_pawn]);
-        attacked_sq |= pawn_north_west(pos.piece_bitboards[w_pawn]);
+    for(pieces = pos.pieces(rook | side) | queens; pieces; pieces &= pieces - 1){
+        attacked_sq |= get_rook_attack_BB(get_lsb(pieces) - 1, pos.occupied());
     }
-
-
+#endif
 
     return attacked_sq;
+#endif
 }
 
 // Returns a bitboard of all pieces of the enemy color attacking the king (the checkers)
-inline Bitboard get_checkers(uint_fast8_t color, const Position& pos){
-    
+template <PieceColor side>
+inline Bitboard get_checkers(const Position& pos){
+    constexpr PieceColor enemy = opponent<side>;
 
     // Checks if the king is under attack
-    Square king_square = get_lsb(pos.piece_bitboards[king | color]) - 1;
+    Square king_square = get_lsb(pos.pieces(king | side)) - 1;
 
 
-    Bitboard attackers = knight_attacks[king_square]&pos.piece_bitboards[b_knight ^ color];
+    Bitboard attackers = knight_attacks[king_square]&pos.pieces(knight | enemy);
 
     //king 
-    attackers |= king_attacks[king_square]&pos.piece_bitboards[b_king ^ color];
+    attackers |= king_attacks[king_square]&pos.pieces(king | enemy);
 
-    attackers |= get_bishop_attack_BB(king_square, ~pos.piece_bitboards[no_piece])&
-                                    (pos.piece_bitboards[b_bishop ^ color]|pos.piece_bitboards[b_queen ^ color]);
+    attackers |= get_bishop_attack_BB(king_square, pos.occupied())&
+                                    (pos.pieces(bishop | enemy)|pos.pieces(queen | enemy));
 
-    attackers |= get_rook_attack_BB(king_square, ~pos.piece_bitboards[no_piece])&
-                                    (pos.piece_bitboards[b_rook ^ color]|pos.piece_bitboards[b_queen ^ color]);
+    attackers |= get_rook_attack_BB(king_square, pos.occupied())&
+                                    (pos.pieces(rook | enemy)|pos.pieces(queen | enemy));
     
-    // Now check if there are pawn attacks:
-    if(color){ 
-        attackers |= (pawn_south_east(pos.piece_bitboards[b_king])|
-                      pawn_south_west(pos.piece_bitboards[b_king]))&
-                      pos.piece_bitboards[w_pawn];
-    }
-    else{
-        attackers |= (pawn_north_east(pos.piece_bitboards[w_king])|
-                      pawn_north_west(pos.piece_bitboards[w_king]))&
-                      pos.piece_bitboards[b_pawn];
-    }
+    // Now check if there are pawn attacks, a pawn of our color on the
+    // king square would attack exactly the enemy pawns that give check
+    attackers |= pawn_attacks<side>(pos.pieces(king | side))&
+                 pos.pieces(pawn | enemy);
 
     return attackers;
 
 }
 
-inline Bitboard attacked_by(uint_fast8_t color, Bitboard squares, const Position& pos){
-    // Returns a bitboard of all pieces of the enemy color attacking the king (the checkers)
+// Pieces of both colors that attack the square, with the given occupancy.
+// Used for exchanges, where the pieces that already captured are removed
+inline Bitboard attackers_to(const Position& pos, Square sq, Bitboard occupied){
+    Bitboard target = 1ULL << sq;
+
+    return (pawn_attacks<black>(target)&pos.pieces(w_pawn))
+           | (pawn_attacks<white>(target)&pos.pieces(b_pawn))
+           | (knight_attacks[sq]&pos.type_pieces(knight))
+           | (king_attacks[sq]&pos.type_pieces(king))
+           | (get_bishop_attack_BB(sq, occupied)&(pos.type_pieces(bishop)|pos.type_pieces(queen)))
+           | (get_rook_attack_BB(sq, occupied)&(pos.type_pieces(rook)|pos.type_pieces(queen)));
+}
+
+// Returns true if any of the squares is attacked by the given color
+template <PieceColor side>
+inline Bitboard attacked_by(Bitboard squares, const Position& pos){
+#ifdef ATTACK_COUNTS
+    return squares & attack_map(pos, side);
+#else
     Bitboard    attackers = 0ULL, 
                 squares_to_check = squares;
     Square      sq;
-    // Checks if the king is under attack
 
-    if(color){ 
-            attackers = (pawn_south_east(pos.piece_bitboards[b_pawn])|
-                        pawn_south_west(pos.piece_bitboards[b_pawn]));
-        }
-    else{
-            attackers = (pawn_north_east(pos.piece_bitboards[w_pawn])|
-                        pawn_north_west(pos.piece_bitboards[w_pawn]));
-        }
+    attackers = pawn_attacks<side>(pos.pieces(pawn | side));
     if(attackers&squares) return true;
 
     while(squares_to_check){
         sq = get_lsb(squares_to_check) - 1;
 
-        attackers |= get_bishop_attack_BB(sq, ~pos.piece_bitboards[no_piece])&
-                     (pos.piece_bitboards[w_bishop | color]|pos.piece_bitboards[w_queen | color]);
+        attackers |= get_bishop_attack_BB(sq, pos.occupied())&
+                     (pos.pieces(bishop | side)|pos.pieces(queen | side));
 
         if(attackers&squares) return true;
 
-        attackers |= get_rook_attack_BB(sq, ~pos.piece_bitboards[no_piece])&
-                     (pos.piece_bitboards[w_rook | color]|pos.piece_bitboards[w_queen | color]);
+        attackers |= get_rook_attack_BB(sq, pos.occupied())&
+                     (pos.pieces(rook | side)|pos.pieces(queen | side));
                      
         if(attackers&squares) return true;
 
-        attackers |= knight_attacks[sq]&pos.piece_bitboards[w_knight | color];
+        attackers |= knight_attacks[sq]&pos.pieces(knight | side);
 
-        attackers |= king_attacks[sq]&pos.piece_bitboards[w_king | color];
+        attackers |= king_attacks[sq]&pos.pieces(king | side);
 
         if(attackers&squares) return true;
 
         squares_to_check &= squares_to_check - 1;
     }
     return false;
+#endif
+}
 
+// True if the king of this color is attacked
+template <PieceColor side>
+inline bool in_check(const Position& pos){
+#ifdef ATTACK_COUNTS
+    return pos.pieces(king | side) & attack_map(pos, opponent<side>);
+#else
+    return get_checkers<side>(pos);
+#endif
 }
 
+inline bool in_check(uint_fast8_t color, const Position& pos){
+    return color ? in_check<black>(pos) : in_check<white>(pos);
+}
 
+inline Bitboard attacked_squares(uint_fast8_t color, const Position& pos){
+    return color ? attacked_squares<black>(pos) : attacked_squares<white>(pos);
+}
+
+inline Bitboard get_checkers(uint_fast8_t color, const Position& pos){
+    return color ? get_checkers<black>(pos) : get_checkers<white>(pos);
+}
+
+inline Bitboard attacked_by(uint_fast8_t color, Bitboard squares, const Position& pos){
+    return color ? attacked_by<black>(squares, pos) : attacked_by<white>(squares, pos);
+}
 
-// (Pseudo) Legality check
 
-bool Position::is_pseudolegal(Move move){
-    Square from = from_square(move);
-    Square to = to_square(move);
-    Piece pce = board[from];
-    PieceColor col;
 
+/*
+Attack information of one node, seen from the side to move. Every part
+is computed on first use and kept, so move generation, the move picker
+and the search share it instead of building the same sets again. It is
+only valid while pos is at this node, so create one per node.
+*/
+class AttackInfo{
+    public:
+        AttackInfo(const Position& position) : pos(position), computed(0) {}
+
+        // Enemy pieces that give check to the side to move
+        Bitboard checkers();
+
+        // All squares attacked by a color
+        Bitboard attacked(PieceColor color);
+
+        // Squares from where a piece of this type of the side to move gives check
+        Bitboard check_squares(PieceType p_type);
+
+        // Pieces of the side to move that give a discovered check when they leave the line to the enemy king
+        Bitboard discoverers();
+
+        // True if the pseudolegal move checks the enemy king, without making it
+        bool gives_check(Move move);
+
+        // For castling moves, true if the king does not pass an attacked square
+        bool castling_path_safe(Move move);
+
+    private:
+        enum ComputedFlags{
+            checkers_done       = 0b1,
+            attacked_white_done = 0b10,
+            attacked_black_done = 0b100,
+            check_squares_done  = 0b1000,
+            discoverers_done    = 0b10000
+        };
+
+        const Position& pos;
+        uint8_t computed;
+
+        Bitboard checkers_bb;
+        Bitboard discoverers_bb;
+        std::array<Bitboard, 2> attacked_bb;
 
-    assert((0 <= from) && (from < 64));
-    assert((0 <= to) && (to < 64));
-    assert(pce != w_piece);
-    assert(pce != b_piece);
+        // Indexed by PieceType - 1
+        std::array<Bitboard, 6> check_squares_bb;
+};
+
+inline Bitboard AttackInfo::checkers(){
+    if(!(computed&checkers_done)){
+        checkers_bb = get_checkers(pos.to_move, pos);
+        computed |= checkers_done;
+    }
+    return checkers_bb;
+}
 
-    if(!(move)) return false;
+inline Bitboard AttackInfo::attacked(PieceColor color){
+    uint8_t flag = color ? attacked_black_done : attacked_white_done;
 
-    // If a piece is present, assign color
-    if(pce){
-        col = pce & color_mask;
+    if(!(computed&flag)){
+        attacked_bb[color >> 3] = attacked_squares(color, pos);
+        computed |= flag;
     }
-    else{
-        // No piece on from square, no move
-        return false;
+    return attacked_bb[color >> 3];
+}
+
+inline Bitboard AttackInfo::check_squares(PieceType p_type){
+    if(!(computed&check_squares_done)){
+        Bitboard enemy_king = pos.pieces(king | (pos.to_move ^ black));
+        Square king_square = get_lsb(enemy_king) - 1;
+
+        // A pawn checks from where a pawn of the enemy on the king square would capture
+        check_squares_bb[pawn - 1]   = pos.to_move ? pawn_attacks<white>(enemy_king)
+                                                   : pawn_attacks<black>(enemy_king);
+        check_squares_bb[knight - 1] = knight_attacks[king_square];
+        check_squares_bb[bishop - 1] = get_bishop_attack_BB(king_square, pos.occupied());
+        check_squares_bb[rook - 1]   = get_rook_attack_BB(king_square, pos.occupied());
+        check_squares_bb[queen - 1]  = check_squares_bb[bishop - 1] | check_squares_bb[rook - 1];
+        check_squares_bb[king - 1]   = 0ULL;
+
+        computed |= check_squares_done;
     }
+    return check_squares_bb[p_type - 1];
+}
 
-    if((move&is_special_pawn_move) && ((pce&type_mask) != pawn)) return false;
-    else if(move&0x8000){
-        Bitboard attacked_sq = attacked_squares(col ^ black, *this);
 
-        switch (move)
-        {
-        case cstl_move_K:
-            return ((castling_rights&cstl_K) 
-                    && (!((~piece_bitboards[no_piece])&cstl_squares_K))
-                    && (!(cstl_traverse_K&attacked_sq))
-                    );
-            break;
-
-        case cstl_move_Q:
-            return ((castling_rights&cstl_Q) 
-                    && (!((~piece_bitboards[no_piece])&cstl_squares_Q))
-                    && (!(cstl_traverse_Q&attacked_sq))
-                    );
-            break;
-
-        case cstl_move_k:
-            return ((castling_rights&cstl_k) 
-                    && (!((~piece_bitboards[no_piece])&cstl_squares_k))
-                    && (!(cstl_traverse_k&attacked_sq))
-                    );
-            break;
-
-        case cstl_move_q:
-            return ((castling_rights&cstl_q) 
-                    && (!((~piece_bitboards[no_piece])&cstl_squares_q))
-                    && (!(cstl_traverse_q&attacked_sq))
-                    );
-            break;
+inline Bitboard AttackInfo::discoverers(){
+    if(!(computed&discoverers_done)){
+        PieceColor us = pos.to_move;
+        Square king_square = get_lsb(pos.pieces(king | (us ^ black))) - 1;
 
+        // Own sliders that would attack the enemy king on an empty board
+        Bitboard snipers = (get_rook_attack_BB(king_square, 0ULL)
+                            & (pos.pieces(rook | us) | pos.pieces(queen | us)))
+                         | (get_bishop_attack_BB(king_square, 0ULL)
+                            & (pos.pieces(bishop | us) | pos.pieces(queen | us)));
 
-        default:
-            return false;
-            break;
+        discoverers_bb = 0ULL;
+        while(snipers){
+            Bitboard blockers = squares_between[king_square][get_lsb(snipers) - 1] & pos.occupied();
+            if(count_bits(blockers) == 1) discoverers_bb |= blockers & pos.color_pieces(us);
+            snipers &= snipers - 1;
         }
-    } //return false;
+        computed |= discoverers_done;
+    }
+    return discoverers_bb;
+}
 
-    if(col ^ to_move) return false;
-    // else if((board[to] == w_king) || (board[to] == b_king)) return false; MADE NO DIFFERENCE
-    else{
-        switch (pce & type_mask)
-        {
-            
-        case king:
-            if  (king_attacks[from]
-                &((~piece_bitboards[col | w_piece])
-                &(1ULL << to))) return true; 
-            break;
+inline bool AttackInfo::gives_check(Move move){
+    Square from = from_square(move);
+    Square to = to_square(move);
+    PieceColor us = pos.to_move;
+    Bitboard enemy_king = pos.pieces(king | (us ^ black));
+    Square king_square = get_lsb(enemy_king) - 1;
+
+    // Direct check, promotions are handled below (0x3000 to 0x6000)
+    bool promotion = (move&0x7000) >= 0x3000;
+    if(!promotion && (check_squares(PieceType(pos.board[from] & type_mask)) & (1ULL << to))) return true;
+
+    // Discovered check, unless the piece stays on the line to the king
+    if((discoverers() & (1ULL << from))
+        && !(squares_between[king_square][to] & (1ULL << from))
+        && !(squares_between[king_square][from] & (1ULL << to))) return true;
+
+    switch (move&0xF000)
+    {
+    case 0:
+    case 0x1000:
+        return false;
+
+    case 0x2000:{
+        // En passant removes two pieces from the lines of the king, the direct check was tested above
+        Square victim = us ? to + 8 : to - 8;
+        Bitboard occupied = (pos.occupied() ^ (1ULL << from) ^ (1ULL << victim)) | (1ULL << to);
 
+        return (get_bishop_attack_BB(king_square, occupied) & (pos.pieces(bishop | us) | pos.pieces(queen | us)))
+               || (get_rook_attack_BB(king_square, occupied) & (pos.pieces(rook | us) | pos.pieces(queen | us)));
+        }
+    case 0x8000:{
+        // Only the rook can give check, it lands next to the king target square
+        Square rook_from = ((to&7) == 6) ? to + 1 : to - 2;
+        Square rook_to = ((to&7) == 6) ? to - 1 : to + 1;
+        Bitboard occupied = pos.occupied() ^ (1ULL << from) ^ (1ULL << rook_from) ^ (1ULL << to) ^ (1ULL << rook_to);
+
+        return get_rook_attack_BB(rook_to, occupied) & enemy_king;
+        }
+    default:{
+        // Promotion, the pawn no longer blocks its own square
+        Bitboard occupied = pos.occupied() ^ (1ULL << from);
 
+        switch ((move >> 12) - 1)
+        {
         case knight:
-            if  (knight_attacks[from]
-                &((~piece_bitboards[col | w_piece])
-                &(1ULL << to))) return true; 
-            break;
-        
+            return knight_attacks[to] & enemy_king;
         case bishop:
-            if( get_bishop_attack_BB(from, ~piece_bitboards[no_piece])
-                &((~piece_bitboards[col | w_piece])
-                &(1ULL << to))) return true;
-            break;
-        
+            return get_bishop_attack_BB(to, occupied) & enemy_king;
         case rook:
-            if( get_rook_attack_BB(from, ~piece_bitboards[no_piece])
-                &((~piece_bitboards[col | w_piece])
-                &(1ULL << to))) return true;
-            break;
-
-        case queen:
-            if( (
-                get_bishop_attack_BB(from, ~piece_bitboards[no_piece])
-                |
-                get_rook_attack_BB(from, ~piece_bitboards[no_piece])
-                )
-                &((~piece_bitboards[col | w_piece])
-                &(1ULL << to))) return true;
-            break;
-
-        
-        case pawn:
-            if(col){
-                // Black
-                switch (from - to)
-                {
-                    case 8:
-                        // straight pawn push
-                        if(!board[to]) return true;
-                        break;
-
-                    case 7:
-                        // capture right 
-                        // Note that the illegal pawn move a2h1 would not be filtered. But it is impossible for the
-                        // move generator to produce this move so it does not need to be checked
-                        if((to&0b111) == 7) return false;
-                        if(!board[to]) return false;
-                        if((board[to] & color_mask) == white) return true;
-                        else if(en_passant == to) return true;
-                        break;
-
-                    case 9:
-                        // capture left
-                        if((to&0b111) == 0) return false;
-                        if(!board[to]) return false;
-                        if((board[to] & color_mask) == white) return true;
-                        else if(en_passant == to) return true;
-                        break;
-
-                    case 16:
-                        // double push, only possible if both squares are free and the pawn is on rank 2
-                        if((!board[to]) && (!board[to + 8]) && (from > 47)) return true;
-                        break;
-                    
-                    default:
-                        break;
-                }
-            }
-            else{
-                // White
-                // First calculate the difference between from and two square
-                switch (to - from)
-                {
-                    case 8:
-                        // straight pawn push
-                        if(!board[to]) return true;
-                        break;
-
-                    case 9:
-                        // capture right 
-                        // Note that the illegal pawn move a2h1 would not be filtered. But it is impossible for the
-                        // move generator to produce this move so it does not need to be checked
-                        if((to&0b111) == 7) return false;
-                        if(board[to] & black) return true;
-                        else if(en_passant == to) return true;
-                        break;
-
-                    case 7:
-                        // capture left
-                        if((to&0b111) == 0) return false;
-                        if(board[to] & black) return true;
-                        else if(en_passant == to) return true;
-                        break;
-
-                    case 16:
-                        // double push, only possible if both squares are free and the pawn is on rank 2
-                        if((!board[to]) && (!board[to - 8]) && (from < 16)) return true;
-                        break;
-                    
-                    default:
-                        break;
-                }
-            }
-            break;
-            
-        
+            return get_rook_attack_BB(to, occupied) & enemy_king;
         default:
-            break;
+            return (get_bishop_attack_BB(to, occupied) | get_rook_attack_BB(to, occupied)) & enemy_king;
+        }
         }
     }
+}
 
-    return false;
+
+// (Pseudo) Legality check
+// Used for moves from the TT, which may come from a different position.
+// Everything is a bitboard test, only castling through attacked squares is
+// left to AttackInfo::castling_path_safe, so it is paid only when the
+// move is actually searched.
+
+template <PieceColor side>
+inline bool is_pseudolegal(const Position& pos, Move move){
+    Square from = from_square(move);
+    Square to = to_square(move);
+    Bitboard from_bb = 1ULL << from;
+    Bitboard to_bb = 1ULL << to;
+    Piece pce = pos.board[from];
+
+    // The piece has to belong to the side to move and can not capture its own pieces
+    if(!(pos.color_pieces(side) & from_bb) || (pos.color_pieces(side) & to_bb)) return false;
+
+    Bitboard enemies = pos.color_pieces(opponent<side>);
+    Bitboard last_rank = pawn_push<side>(pawn_promotion_rank<side>);
+
+    switch (move&0xF000)
+    {
+    case 0:
+        break;
+    case 0x1000:
+        return (pce == (pawn | side))
+               && (pawn_push<side>(pawn_push<side>(from_bb & pawn_promotion_rank<opponent<side>>) & pos.free_squares())
+                   & pos.free_squares() & to_bb);
+    case 0x2000:
+        return (pce == (pawn | side)) && pos.en_passant && (to == pos.en_passant) && (pawn_attacks<side>(from_bb) & to_bb);
+    case 0x3000:
+    case 0x4000:
+    case 0x5000:
+    case 0x6000:
+        return (pce == (pawn | side)) && (to_bb & last_rank)
+               && ((pawn_push<side>(from_bb) & pos.free_squares() & to_bb) || (pawn_attacks<side>(from_bb) & enemies & to_bb));
+    case 0x8000:
+        // Only the right, the empty squares and the king are checked here
+        if(move == cstl_move_kingside<side>) return (pos.castling_rights&cstl_kingside<side>)
+                                                    && !(pos.occupied()&cstl_squares_kingside<side>)
+                                                    && (pce == (king | side));
+        if(move == cstl_move_queenside<side>) return (pos.castling_rights&cstl_queenside<side>)
+                                                     && !(pos.occupied()&cstl_squares_queenside<side>)
+                                                     && (pce == (king | side));
+        return false;
+    default:
+        return false;
+    }
+
+    switch (pce & type_mask)
+    {
+    case pawn:
+        if(to_bb & last_rank) return false;
+        return (pawn_push<side>(from_bb) & pos.free_squares() & to_bb) || (pawn_attacks<side>(from_bb) & enemies & to_bb);
+    case knight:
+        return knight_attacks[from] & to_bb;
+    case bishop:
+        return get_bishop_attack_BB(from, pos.occupied()) & to_bb;
+    case rook:
+        return get_rook_attack_BB(from, pos.occupied()) & to_bb;
+    case queen:
+        return (get_bishop_attack_BB(from, pos.occupied()) | get_rook_attack_BB(from, pos.occupied())) & to_bb;
+    case king:
+        return king_attacks[from] & to_bb;
+    default:
+        return false;
+    }
 }
 
+bool Position::is_pseudolegal(Move move) const{
+    if(to_move) return ::is_pseudolegal<black>(*this, move);
+    else        return ::is_pseudolegal<white>(*this, move);
+}
+
+inline bool AttackInfo::castling_path_safe(Move move){
+    Bitboard traverse;
+    switch (move)
+    {
+    case cstl_move_K: traverse = cstl_traverse_K; break;
+    case cstl_move_Q: traverse = cstl_traverse_Q; break;
+    case cstl_move_k: traverse = cstl_traverse_k; break;
+    case cstl_move_q: traverse = cstl_traverse_q; break;
+    default: return true;
+    }
+    return !(traverse & attacked(pos.to_move ^ black));
+}
 
-// Place, move and remove piece from bitboards
-// NOTE: the array is still seperately handled
 
-// White
+// Place, move and remove piece from bitboards
+// NOTE: the array is still seperately handled, pce must not be no_piece
 
 inline void move_piece(Position& pos, Square from, Square to, uint8_t pce)
 {
-    pos.piece_bitboards[pce] ^= (1ULL << from) | (1ULL << to);
+    pos.type_bitboards[(pce&type_mask) - 1] ^= (1ULL << from) | (1ULL << to);
+    pos.color_bitboards[pce >> 3] ^= (1ULL << from) | (1ULL << to);
 }
 
 inline void place_piece(Position& pos, Square sq, uint8_t pce)
 {
-    pos.piece_bitboards[pce] ^= 1ULL << (sq);
+    pos.type_bitboards[(pce&type_mask) - 1] ^= 1ULL << (sq);
+    pos.color_bitboards[pce >> 3] ^= 1ULL << (sq);
 }
 
 // Same as place but for readability
 inline void remove_piece(Position& pos, Square sq, uint8_t pce)
 {
-    pos.piece_bitboards[pce] ^= 1ULL << (sq);  
+    pos.type_bitboards[(pce&type_mask) - 1] ^= 1ULL << (sq);
+    pos.color_bitboards[pce >> 3] ^= 1ULL << (sq);
 }
 
 inline void Position::push_history(Piece moved, Piece target, Move move)
 {
-    position_history[total_move_count++] = 
+    history.entries[history.size++] = 
                     UndoObject(moved, target, move, 
                                 en_passant, 
                                 castling_rights,
                                 halfmove_clock, 
-                                position_key);
+                                position_key,
+                                pawn_key);
 }
 
+#ifdef COPY_MAKE
+// Has to be called before push_history and pop_history, both use the history size as index
+inline void Position::push_snapshot()
+{
+    snapshot_history[history.size] = *this;
+}
+
+inline void Position::pop_snapshot()
+{
+    static_cast<BoardState&>(*this) = snapshot_history[history.size - 1];
+}
+#endif
+
 inline UndoObject Position::get_last_history()
 {
-    return position_history[total_move_count - 1];
+    return history.entries[history.size - 1];
 }
 
 inline UndoObject Position::pop_history()
 {
-    return position_history[--total_move_count];
+    return history.entries[--history.size];
 }
 
 inline bool Position::is_repetition()
 {
     // OPTION 1:
     /*
-    return std::count_if(position_history.begin(), position_history.end(), [this](UndoObject obj){
+    return std::count_if(history.entries.begin(), history.entries.end(), [this](UndoObject obj){
         return (obj.position_key == this->position_key);
     });*/
     /*
@@ -828,57 +1100,11 @@ inline bool Position::is_repetition()
     // stop checking after halfmove is done
 
     for(char i = 2; i < (halfmove_clock/2); i++){
-        if(position_history[total_move_count - (2 << i)].position_key == position_key) return true;
+        if(history.entries[history.size - (2 << i)].position_key == position_key) return true;
     }
     return false;
 }
 
 
 
-/*
-template <Colors side, typename std::enable_if <side == white> :: type* = nullptr> 
-inline void place_piece(Position& pos, Square sq, Piece pce)
-{
-    pos.piece_bitboards[no_piece] ^= 1ULL << (sq);
-    pos.piece_bitboards[pce] ^= 1ULL << (sq);
-    pos.piece_bitboards[w_piece] ^= 1ULL << (sq);   
-}
-
-// The same exact functions as above, but it makes the code more readable
-template <Colors side, typename std::enable_if <side == white> :: type* = nullptr> 
-inline void remove_piece(Position& pos, Square sq, Piece pce)
-{
-    pos.piece_bitboards[no_piece] ^= 1ULL << (sq);
-    pos.piece_bitboards[pce] ^= 1ULL << (sq);
-    pos.piece_bitboards[w_piece] ^= 1ULL << (sq);   
-}
-
-// Black
-
-template <Colors side, typename std::enable_if <side == black> :: type* = nullptr> 
-inline void move_piece(Position& pos, Square from, Square to, Piece pce)
-{
-    pos.piece_bitboards[no_piece] ^= (1ULL << from) | (1ULL << to);
-    pos.piece_bitboards[pce] ^= (1ULL << from) | (1ULL << to);
-    pos.piece_bitboards[b_piece] ^= (1ULL << from) | (1ULL << to);  
-}
-
-template <Colors side, typename std::enable_if <side == black> :: type* = nullptr> 
-inline void place_piece(Position& pos, Square sq, Piece pce)
-{
-    pos.piece_bitboards[no_piece] ^= 1ULL << (sq);
-    pos.piece_bitboards[pce] ^= 1ULL << (sq);
-    pos.piece_bitboards[b_piece] ^= 1ULL << (sq);    
-}
-
-template <Colors side, typename std::enable_if <side == black> :: type* = nullptr> 
-inline void remove_piece(Position& pos, Square sq, Piece pce)
-{
-    pos.piece_bitboards[no_piece] ^= 1ULL << (sq);
-    pos.piece_bitboards[pce] ^= 1ULL << (sq);
-    pos.piece_bitboards[b_piece] ^= 1ULL << (sq);    
-}
-
-*/
-
 #endif //POSITION_H
\ No newline at end of file
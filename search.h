@@ -3,6 +3,9 @@
 #include <iostream>
 #include <chrono>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
 // uncomment to disable assert()
 #define NDEBUG
 #include <cassert>
@@ -17,47 +20,196 @@
 #include "movepicker.h"
 #include "position_tables.h"
 #include "table.h"
+#include "pawns.h"
+#include "material.h"
+#include "mobility.h"
+#ifdef NNUE
+#include "nnue.h"
+#endif
+
+
+/*
+The search is one template for the three kinds of nodes:
+
+    Root    the moves come from root_moves, the lines of MultiPV are
+            searched one after another with the moves of the earlier
+            lines left out. No table cutoffs, pruning or extensions
+    PV      open window, the first move is searched with it and the
+            others with a null window, again with the open window if
+            they beat alpha. Only these nodes keep a PV
+    NonPV   null window, all moves are expected to fail the same way
+
+The PV bookkeeping and the root handling compile away at the NonPV nodes.
+*/
+enum NodeType{
+    Root,
+    PV,
+    NonPV
+};
+
+template <NodeType node_type>
+int search(int alpha, int beta, int depth, int ply);
+inline int eval(int alpha = -infinity_score, int beta = infinity_score);
+void prepare_tables(const Position& position);
 
+/*
+The eval is lazy: it adds its terms in stages from cheap to expensive and
+stops after a stage if the score is so far outside the window (alpha, beta)
+that the remaining terms can not bring it back. The margins are above
+what the remaining terms add in 99% of the positions:
 
-int search(int alpha, int beta, int depth);
-void prepare_tables(const Position& position);
+    Stage 0     piece square sums, kept up to date by make_move, and the
+                imbalance from the material table
+    Stage 1     pawn structure from the pawn table
+    Full        mobility and king safety
+
+An eval that stops early is not exact, so it is not stored in the eval
+cache. Without a window the eval always runs all stages.
+*/
+constexpr std::array<int, 2> lazy_margin = {400, 350};
+
+unsigned long long lazy_eval_calls;
+std::array<unsigned long long, 2> lazy_eval_exits;
 
-constexpr uint8_t max_pv_len  = 32;
+constexpr int max_search_ply = 64;
+constexpr uint8_t max_pv_len  = max_search_ply;
 
-// Triangular array to store the PV
-// the final PV ends up at pv[max_pv_len*depth] and is as long as depth
+// Triangular array to store the PV, indexed by the ply from the root
+// The PV of a node is at pv[max_pv_len*ply] and is pv_length[ply] long,
+// the final PV ends up at pv[0]
 std::array<Move, max_pv_len*max_pv_len> principal_variation = {0};
+std::array<int, max_search_ply> pv_length = {0};
+
+// Depth of the current iteration, the extensions are limited by it
+int root_depth;
+
+// Set by another thread to end a search. The nodes return right away, their
+// scores are not used and nothing is stored for them
+std::atomic<bool> stop_search{false};
+
+// While set, the search runs on the opponent's time: it keeps going deeper
+// and prints nothing. Clearing it turns it into a normal search
+std::atomic<bool> pondering{false};
+
+inline bool search_stopped(){
+    return stop_search.load(std::memory_order_relaxed);
+}
 
 Position pos;
 
 unsigned long long node_count;
+// QS nodes, counted apart from the main search
+unsigned long long qs_node_count;
+
+// QS pruning margin in centipawns, a capture has to come this close to alpha
+constexpr int delta_margin = 200;
+
+// Pruning before and while searching the moves of a node, margins in centipawns.
+// Reverse futility returns beta if the static eval is this far above it
+constexpr int reverse_futility_depth = 3;
+constexpr int reverse_futility_margin = 120; // per ply of depth
+
+// Razoring drops into the QS if the static eval is this far below alpha
+constexpr int razoring_depth = 2;
+constexpr std::array<int, razoring_depth + 1> razoring_margin = {0, 250, 450};
+
+// Futility skips quiet moves if the static eval is this far below alpha
+constexpr int futility_depth = 3;
+constexpr std::array<int, futility_depth + 1> futility_margin = {0, 150, 300, 450};
+
+// ProbCut: a capture that wins enough by SEE is searched with a reduced depth
+// against beta + probcut_margin, if it holds the node fails high
+constexpr int probcut_depth = 5;
+constexpr int probcut_margin = 200;
+constexpr int probcut_reduction = 4;
+
+// Singular extensions: the TT move is extended if no other move gets within
+// singular_margin*depth of its score in a search of half the depth
+constexpr int singular_depth = 6;
+constexpr int singular_margin = 10; // per ply of depth
+
+// Static eval is not computed in check
+constexpr int no_eval = -infinity_score;
+
+// What the search keeps per ply from the root
+struct SearchStackEntry{
+    int static_eval;
+    // Skipped by the search for singular extensions
+    Move excluded_move;
+};
+
+std::array<SearchStackEntry, max_search_ply> search_stack;
+
+// Counts how often each pruning technique cut and each extension was
+// applied, over a whole search
+struct SearchStats{
+    unsigned long long reverse_futility;
+    unsigned long long razoring;
+    unsigned long long futility;
+    unsigned long long probcut;
+
+    unsigned long long check_extensions;
+    unsigned long long singular_searches;
+    unsigned long long singular_extensions;
+};
+
+// Puts the move in front of the PV of the next ply
+inline void update_pv(int ply, Move move){
+    principal_variation[max_pv_len*ply] = move;
+
+    std::copy_n(&principal_variation[max_pv_len*(ply + 1)],
+                pv_length[ply + 1],
+                &principal_variation[max_pv_len*ply + 1]);
+
+    pv_length[ply] = pv_length[ply + 1] + 1;
+}
 
+SearchStats search_stats;
 
-void display_search_result(int depth, int score, unsigned long long total_nodes, int time){
-    // Print depth
-    std::cout << "D" << depth << ": ";
+// A legal move of the root position with what the search knows about it
+struct RootMove{
+    Move move;
 
-    // Display score as well as PV
-    if(abs(score) >= checkmate_score){
-        short mate_in = 0;
+    // Only exact for moves that were the best of a line at some point,
+    // the other moves have -infinity_score and illegal ones -illegal_position
+    int score;
+
+    // Nodes of the subtree in the last iteration, main search and QS
+    unsigned long long nodes;
+
+    std::array<Move, max_pv_len> pv;
+    int pv_length;
+};
+
+// Root moves of the current search, kept over all iterations
+std::vector<RootMove> root_moves;
+
+// Line of MultiPV that is searched, the moves before it are the best of the earlier lines
+size_t pv_line;
+
+// Order of the root moves for the next iteration: the best lines by score,
+// then the others by the size of their subtree
+inline bool root_move_before(const RootMove& x, const RootMove& y){
+    if(x.score != y.score) return x.score > y.score;
+    return x.nodes > y.nodes;
+}
 
-        if(score > 0) 
-            mate_in = (1 + depth - (abs(score) - checkmate_score))/2;
-        else
-            mate_in = (-(1 + depth) + (abs(score) - checkmate_score))/2;
+void display_score(int score){
+    if(abs(score) >= mate_score_bound){
+        // Plies to the mate, the mating side moves on the odd ones
+        short mate_in = (checkmate_score - abs(score) + 1)/2;
+        if(score < 0) mate_in = -mate_in;
 
         std::cout << "#" << mate_in << "  ";
     }
-    else if(principal_variation[max_pv_len*depth] == 0){
-        std::cout << "Stalemate" << "  ";
-    }
     else std::cout << (1.0f*score)/100 << "  ";
+}
 
-    // Show Nodes and time on same line then on next line PV
-    std::cout << "Nodes: " << total_nodes << " Time: " << time/1000.0f << std::endl << "PV: ";
+void display_pv(const Move* pv, int length){
+    std::cout << "PV: ";
 
-    for(int i=0; i<depth; i++){
-        Move move = principal_variation[max_pv_len*depth + i];
+    for(int i=0; i<length; i++){
+        Move move = pv[i];
         
         std::cout           << square_names[from_square(move)] 
                             << square_names[to_square(move)]  
@@ -66,106 +218,146 @@ void display_search_result(int depth, int score, unsigned long long total_nodes,
     std::cout << std::endl;
 }
 
+void display_search_result(int depth, int score, unsigned long long total_nodes, unsigned long long qs_nodes, int time){
+    // Print depth
+    std::cout << "D" << depth << ": ";
 
-Move search_position(Position& root_position, int min_depth){
+    // Display score as well as PV
+    if((abs(score) < mate_score_bound) && (pv_length[0] == 0)){
+        std::cout << "Stalemate" << "  ";
+    }
+    else display_score(score);
+
+    // Show Nodes and time on same line then on next line PV
+    std::cout << "Nodes: " << total_nodes << " QS nodes: " << qs_nodes << " Time: " << time/1000.0f << std::endl;
+
+    display_pv(&principal_variation[0], pv_length[0]);
+}
+
+// The lines after the best one in MultiPV mode, numbered from 1 for the best
+void display_line(int line, int score, const RootMove& root_move){
+    std::cout << "  Line " << line << ": ";
+    display_score(score);
+    display_pv(&root_move.pv[0], root_move.pv_length);
+}
+
+
+// With multi_pv > 1 the best moves after the first one are searched
+// as well, each without the moves of the lines before it. All lines are
+// printed after every iteration. With keep_table the entries of the last
+// search are used again, the moves played since have to be the same
+Move search_position(Position& root_position, int min_depth, int multi_pv = 1, bool keep_table = false){
     int score = 0;
     Move best_move = 0;
     unsigned long total_nodes = 0;
+    unsigned long total_qs_nodes = 0;
     int depth = 1;
 
     bool done = false;
 
-    pos = root_position;
+    // Only copies the board and the moves played so far
+    pos.copy_from(root_position);
     prepare_tables(pos);
 
-    clear_table();
+    if(!keep_table) clear_table();
 
-    for (int i = 0; i < pos.total_move_count; i++){
-        store_entry(pos.position_history[i].position_key,
+    for (int i = 0; i < pos.move_count(); i++){
+        store_entry(pos.history.entries[i].position_key,
                     0,
                     0,
                     const_entry,
                     47);
     }
 
-    std::cout   << "Table size: " << tbl_size*sizeof(TableEntry)/(1024.0f*1024.0f) << " Mb, " 
-                << tbl_size << " entries." << std::endl;
+    if(!pondering){
+        std::cout   << "Table size: " << tbl_size*sizeof(TableEntry)/(1024.0f*1024.0f) << " Mb, " 
+                    << tbl_size << " entries." << std::endl;
+    }
 
 
     principal_variation = {0};
+    pv_length = {0};
+    search_stack = {};
+    search_stats = SearchStats();
+    pawn_table_probes = 0;
+    pawn_table_hits = 0;
+    eval_cache_probes = 0;
+    eval_cache_hits = 0;
+    lazy_eval_calls = 0;
+    lazy_eval_exits = {0, 0};
+
+    // The root moves are kept over all iterations, sorted by their last score
+    root_moves.clear();
+    {
+        // The first iteration takes the moves in the order of the move picker
+        AttackInfo attack_info(pos);
+        MovePicker move_picker(pos, attack_info);
+
+        while(Move move = move_picker.pick_next_move()){
+            root_moves.push_back(RootMove{move, -infinity_score, 0, {}, 0});
+        }
+    }
 
     auto full_start = std::chrono::high_resolution_clock::now();
     while(!done){
         // Reset node count to count only for current iteration
         node_count = 0;
+        qs_node_count = 0;
 
     
         auto start = std::chrono::high_resolution_clock::now();
         // Search for best move
         //score = search(-infinity_score, infinity_score, depth);
 
-        MovePicker move_picker(pos);
+        root_depth = depth;
 
-        TableEntry table_entry = probe_table(pos.position_key);
-        if(table_entry.info != 0){
-            if(pos.is_pseudolegal(table_entry.move)) {
-                move_picker.add_move(table_entry.move);
-            }
+        for(RootMove& root_move : root_moves){
+            root_move.score = -infinity_score;
         }
 
-        Move move = move_picker.pick_next_move();
-        best_move = 0;
-
-
-        short moves_played = 0;
-
-
         int best_score = -infinity_score;
+        size_t lines = 0;
 
-        score = 0;
-
-        while(move){;
-
-            make_move(pos, move);
+        // Every line searches the moves that are not the best of an earlier line
+        for(pv_line = 0; (pv_line < size_t(multi_pv)) && (pv_line < root_moves.size()); pv_line++){
+            int line_score = search<Root>(-infinity_score, infinity_score, depth, 0);
 
-            score = -search(-infinity_score, -best_score, depth - 1);
-            //score += incremental_eval(pos, move);
-
-            if(score == -illegal_position){
-                    // If the move was illegal, just undo and search the next one
-                    unmake_move(pos);
-                    move = move_picker.pick_next_move();
-                    continue;
-                }
-
-            unmake_move(pos);
-
-            moves_played++;
+            if(search_stopped()) break;
 
+            // Illegal moves are only searched by the first line of the first iteration
+            if(pv_line == 0){
+                best_score = line_score;
+                std::erase_if(root_moves, [](const RootMove& root_move){return root_move.score == -illegal_position;});
+                if(root_moves.empty()) break;
+            }
+            lines++;
 
-            // If a score surpasses alpha, a new best move is found.
-            if(score > best_score){
+            // The best move of the line goes to its place, the earlier best moves come after it
+            std::stable_sort(root_moves.begin() + pv_line, root_moves.end(),
+                             [](const RootMove& x, const RootMove& y){return x.score > y.score;});
+        }
 
-                best_score = score;
+        // The unfinished iteration is thrown away, the best move is the one of the last
+        if(search_stopped()) break;
 
-                principal_variation[max_pv_len*depth] = best_move = move;
-                
-                
-                std::copy_n(  &principal_variation[(max_pv_len*(depth - 1))],
-                            depth-1,
-                            &principal_variation[(max_pv_len*depth) + 1]);
-            
+        // The lines are sorted already, the rest of the moves only once here
+        std::stable_sort(root_moves.begin() + lines, root_moves.end(), root_move_before);
 
-            }
-
-            move = move_picker.pick_next_move();
+        best_move = 0;
 
-        }
-        if(moves_played == 0){
-            if(get_checkers(pos.to_move, pos))  best_score = -(checkmate_score + depth);
-            else                                best_score = stalemate_score;
+        // Checkmate or stalemate, the score is the one of the root node
+        if(root_moves.empty()){
+            pv_length[0] = 0;
             done = true;
         }
+        else{
+            best_move = root_moves[0].move;
+
+            // The later lines overwrote the PV of the first one
+            std::copy_n(&root_moves[0].pv[0], root_moves[0].pv_length, &principal_variation[0]);
+            pv_length[0] = root_moves[0].pv_length;
+        }
+        score = best_score;
 
         store_entry(pos.position_key, best_move, best_score, exact_score, depth);
 
@@ -180,23 +372,41 @@ Move search_position(Position& root_position, int min_depth){
 
         // Update values:
         total_nodes += node_count;
+        total_qs_nodes += qs_node_count;
 
-        //best_move = principal_variation[max_pv_len*depth];
 
-        if(moves_played == 1) done = true; // FIS SCORE (USE LAST SCORE)
+        if(multi_pv == 1){
+            if(root_moves.size() == 1) done = true;
 
-        // If a checkmate is found for the side to move, stop search and play
-        if(score >= checkmate_score) done = true;
+            // If a checkmate is found for the side to move, stop search and play
+            if(score >= mate_score_bound) done = true;
+        }
+        // The other lines go on to the depth asked for, unless all of them are mates
+        else if(std::all_of(root_moves.begin(), root_moves.begin() + lines,
+                            [](const RootMove& root_move){return abs(root_move.score) >= mate_score_bound;})){
+            done = true;
+        }
 
         //OUTPUT:
 
         if(pos.to_move == black) score = -score;
 
         // When done, print the score and principal variation
-        display_search_result(depth, score, node_count, duration.count());
+        if(!pondering){
+            display_search_result(depth, score, node_count, qs_node_count, duration.count());
+
+            for(size_t line = 1; line < lines; line++){
+                int line_score = (pos.to_move == black) ? -root_moves[line].score : root_moves[line].score;
+                display_line(line + 1, line_score, root_moves[line]);
+            }
+        }
         
+        // The time spent pondering counts, so after a ponder hit the search ends sooner
         duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - full_start);
-        if((depth >= min_depth) && ((duration.count()/1000.0f) > 1.2f)) done = true;
+        if(!pondering && (depth >= min_depth) && ((duration.count()/1000.0f) > 1.2f)) done = true;
+
+        // Pondering on a position with few moves would go through the iterations quickly
+        if(depth == max_search_ply - 1) done = true;
         
         depth++;
 
@@ -210,10 +420,27 @@ Move search_position(Position& root_position, int min_depth){
         if(entry.info) filled_entries++;
     }
     // Print final node count and total time of all iterations combined
-    std::cout << "Total time: " << full_duration.count()/1000.0f << 
-                " Total nodes: " << total_nodes << 
-                " Table fill status: " << filled_entries*100.0f/tbl_size << "% " <<
-                std::endl;
+    if(!pondering){
+        std::cout << "Total time: " << full_duration.count()/1000.0f << 
+                    " Total nodes: " << total_nodes <<
+                    " QS nodes: " << total_qs_nodes << 
+                    " Table fill status: " << filled_entries*100.0f/tbl_size << "% " <<
+                    " Pawn table hits: " << pawn_table_hits*100.0f/std::max(pawn_table_probes, 1ULL) << "%" <<
+                    " Eval cache hits: " << eval_cache_hits*100.0f/std::max(eval_cache_probes, 1ULL) << "%" <<
+                    std::endl;
+        std::cout   << "Lazy eval exits: piece squares " << lazy_eval_exits[0]*100.0f/std::max(lazy_eval_calls, 1ULL) << "%" <<
+                    " pawns " << lazy_eval_exits[1]*100.0f/std::max(lazy_eval_calls, 1ULL) << "%" <<
+                    " of " << lazy_eval_calls << " evals" << std::endl;
+        std::cout   << "Pruned: reverse futility " << search_stats.reverse_futility <<
+                    " razoring " << search_stats.razoring <<
+                    " futility " << search_stats.futility <<
+                    " probcut " << search_stats.probcut << std::endl;
+        // Extension rates are per node of the main search
+        std::cout   << "Extended: check " << search_stats.check_extensions <<
+                    " (" << search_stats.check_extensions*100.0f/std::max(total_nodes, 1UL) << "%)" <<
+                    " singular " << search_stats.singular_extensions << " of " << search_stats.singular_searches <<
+                    " tried (" << search_stats.singular_extensions*100.0f/std::max(total_nodes, 1UL) << "%)" << std::endl;
+    }
 
     
     
@@ -221,50 +448,201 @@ Move search_position(Position& root_position, int min_depth){
     
 }
 
-// Quiet Position evaluation
-inline int eval(){
+// Quiet Position evaluation, from the side to move's point of view. exact
+// is cleared if a stage was outside the window and the rest was skipped
+inline int evaluate_position(int alpha, int beta, bool& exact){
 
-    int score = 0;
-    for(int sq = 0; sq < 64; sq++){
-        if(pos.board[sq]&black) score -= piece_square_tbl[64*pos.board[sq] + sq] << 2;
-        else score += piece_square_tbl[64*pos.board[sq] + sq] << 2;
+    const MaterialEntry& material = probe_material_table(pos);
+
+#ifdef NNUE
+    // The known endgames are still left to their evaluators
+    if(nnue_loaded && !material.evaluate) return nnue_evaluate(pos);
+#endif
+
+    if(material.evaluate) return pos.to_move ? -material.evaluate(pos) : material.evaluate(pos);
+
+    // The phase of this position, not of the root
+    auto score_of = [&](int opening, int endgame){
+        int score = (opening*(256 - material.phase) + endgame*material.phase)/256 + material.imbalance;
+        score = score*((score > 0) ? material.white_scale : material.black_scale)/64;
+        return pos.to_move ? -score : score;
+    };
+    auto outside_window = [&](int score, int stage){
+        if((score + lazy_margin[stage] > alpha) && (score - lazy_margin[stage] < beta)) return false;
+        lazy_eval_exits[stage]++;
+        exact = false;
+        return true;
+    };
+
+    lazy_eval_calls++;
+
+    int opening = 4*pos.psqt_opening;
+    int endgame = 4*pos.psqt_endgame;
+
+    int score = score_of(opening, endgame);
+    if(outside_window(score, 0)) return score;
+
+    const PawnEntry& pawns = probe_pawn_table(pos);
+    opening += pawns.opening;
+    endgame += pawns.endgame;
+
+    score = score_of(opening, endgame);
+    if(outside_window(score, 1)) return score;
+
+    evaluate_mobility<white>(pos, opening, endgame);
+    evaluate_mobility<black>(pos, opening, endgame);
+
+    return score_of(opening, endgame);
+}
+
+// The cached eval, every eval of the search goes through here. The QS
+// passes its window, so the eval can stop early in lost or won positions
+inline int eval(int alpha, int beta){
+    int score;
+    if(probe_eval_cache(pos.position_key, score)) return score;
+
+    bool exact = true;
+    score = evaluate_position(alpha, beta, exact);
+    if(exact) store_eval_cache(pos.position_key, score);
+    return score;
+}
+
+// Material a move wins in centipawns, the victim and what a pawn promotes to
+inline int capture_gain(Move move){
+    int gain = material_value[pos.board[to_square(move)]];
+
+    if((move&0xF000) == 0x2000) gain = material_value[pawn];
+    // 0x3000 is a knight up to 0x6000 for a queen
+    else if((move&0x7000) >= 0x3000) gain += material_value[(move >> 12) - 1] - material_value[pawn];
+
+    return 100*gain;
+}
+
+// Most material one capture of the side to move can win
+inline int max_capture_gain(){
+    PieceColor enemy = black ^ pos.to_move;
+    int gain = 0;
+
+    for(int p_type = queen; p_type >= pawn; p_type--){
+        if(pos.pieces(p_type | enemy)){
+            gain = material_value[p_type];
+            break;
+        }
     }
 
-    if(pos.to_move) return -score;
-    else return score;
-    
+    Bitboard promoting = pos.to_move ? pos.pieces(b_pawn) & pawn_promotion_rank<black>
+                                     : pos.pieces(w_pawn) & pawn_promotion_rank<white>;
+    if(promoting) gain += material_value[queen] - material_value[pawn];
+
+    return 100*gain;
 }
 
 //Quiescience Search
-int qs_search(int alpha, int beta){
+// On the first ply quiet checks are searched after the captures. A side
+// in check has no stand pat, it has to find an evasion or it is mated.
+// qs_ply counts the plies of the QS, ply the plies from the root.
+int qs_search(int alpha, int beta, int qs_ply, int ply){
 
-    if(get_checkers(black ^ pos.to_move, pos)){
+    // The tables are probed after the legality check, until then the slots are loaded
+    if(use_qs_table) prefetch_entry(pos.position_key);
+    prefetch_eval_cache(pos.position_key);
+
+    if(in_check(black ^ pos.to_move, pos)){
         // This position is illegal
         return illegal_position;
     }
 
-    int stand_pat = eval();
+    qs_node_count++;
+
+    // Every entry is deep enough for the QS
+    TableEntry table_entry = use_qs_table ? probe_table(pos.position_key) : TableEntry();
+    if(table_entry.validation_key){
+        table_entry.score = score_from_table(table_entry.score, ply);
+
+        switch (table_entry.info&entry_flag_mask)
+        {
+        case lower_bound:
+            if(table_entry.score >= beta) return beta;
+            break;
+
+        case upper_bound:
+            if(table_entry.score <= alpha) return alpha;
+            break;
+
+        case exact_score:
+            if(table_entry.score >= beta) return beta;
+            else if(table_entry.score <= alpha) return alpha;
+            else return table_entry.score;
+            break;
+        case const_entry:
+            return table_entry.score;
+        default:
+            break;
+        }
+    }
 
-    if(stand_pat >= beta) return beta;
-    if(alpha < stand_pat) alpha = stand_pat;
+    AttackInfo attack_info(pos);
+    bool evading = attack_info.checkers();
+
+    int original_alpha = alpha;
+    int stand_pat = 0;
+
+    if(!evading){
+        stand_pat = eval(alpha, beta);
+
+        if(stand_pat >= beta){
+            if(use_qs_table) store_qs_entry(pos.position_key, 0, stand_pat, lower_bound);
+            return beta;
+        }
+        if(alpha < stand_pat) alpha = stand_pat;
+
+        // Big delta: not even the best capture reaches alpha. The first ply
+        // still has its quiet checks to search
+        if((qs_ply > 0) && (stand_pat + max_capture_gain() + delta_margin <= alpha)) return alpha;
+    }
+
+    // All moves are generated as evasions, otherwise only captures and maybe checks
+    MovePicker move_picker(pos, attack_info);
+    if(!evading){
+        move_picker.set_qs(qs_ply == 0);
+
+        // A quiet move from the main search is only tried if it is a check QS would search
+        Move tt_move = table_entry.move;
+        if(tt_move && (pos.board[to_square(tt_move)] || ((tt_move&0xF000) == 0x2000)
+                       || ((qs_ply == 0) && pos.is_pseudolegal(tt_move) && attack_info.gives_check(tt_move)))){
+            move_picker.add_tt_move(tt_move);
+        }
+    }
+    else if(table_entry.move) move_picker.add_tt_move(table_entry.move);
 
-    MovePicker move_picker(pos);
-    move_picker.set_qs();
     Move move = move_picker.pick_next_move();
+    Move best_move = 0;
+
+    short moves_played = 0;
 
     int score;
 
     while(move){
         // Do not look at pawn captures.
-        // The moves are ordered via MVV/LVA, thus just return if
-        // the captured piece is a pawn
-        if(pos.board[to_square(move)] == w_pawn) return alpha;
-        if(pos.board[to_square(move)] == b_pawn) return alpha;
+        // The captures are ordered via MVV/LVA, thus the pawn captures come
+        // last and only the quiet checks are left after them
+        if(!evading && ((pos.board[to_square(move)]&type_mask) == pawn)){
+            move = move_picker.pick_next_move();
+            continue;
+        }
+
+        // Delta pruning: the capture can not win enough to reach alpha, unless
+        // it checks. That also keeps the quiet checks of the first ply
+        if(!evading && (stand_pat + capture_gain(move) + delta_margin <= alpha)
+           && !attack_info.gives_check(move)){
+            move = move_picker.pick_next_move();
+            continue;
+        }
 
         // Actual QS
         make_move(pos, move);
 
-        score = -qs_search(-beta, -alpha);
+        score = -qs_search(-beta, -alpha, qs_ply + 1, ply + 1);
         //score += incremental_eval(pos, move);
 
         if(score == -illegal_position){
@@ -276,17 +654,24 @@ int qs_search(int alpha, int beta){
 
         unmake_move(pos);
 
-        move = move_picker.pick_next_move();
+        moves_played++;
 
-        
         if(score > alpha){
             if(score >= beta){
+                if(use_qs_table) store_qs_entry(pos.position_key, move, score_to_table(score, ply), lower_bound);
                 return beta;
             }
             alpha = score;
+            best_move = move;
         }
+
+        move = move_picker.pick_next_move();
     }
 
+    // No evasion, mated at the horizon
+    if(evading && (moves_played == 0)) alpha = -checkmate_score + ply;
+
+    if(use_qs_table) store_qs_entry(pos.position_key, best_move, score_to_table(alpha, ply), (alpha > original_alpha) ? exact_score : upper_bound);
     return alpha;
 }
 
@@ -298,35 +683,64 @@ int qs_search(int alpha, int beta){
 
 
 // Main Search
-int search(int alpha, int beta, int depth){
-    
-    
-    if (depth == 0){
+template <NodeType node_type>
+int search(int alpha, int beta, int depth, int ply){
+    constexpr bool root_node = (node_type == Root);
+    constexpr bool pv_node = (node_type != NonPV);
+
+    if constexpr(pv_node) pv_length[ply] = 0;
+
+    // The stack ends well after the extensions stop, this is only a safeguard
+    if ((depth == 0) || (ply >= max_search_ply - 1)){
         
-        return qs_search(alpha,beta);
+        return qs_search(alpha, beta, 0, ply);
     } 
     
-    if(get_checkers(black ^ pos.to_move, pos)){
-        // This position is illegal
-        return illegal_position;
+    if constexpr(!root_node){
+        if(in_check(black ^ pos.to_move, pos)){
+            // This position is illegal
+            return illegal_position;
+        }
+
+        // if(pos.is_repetition()) return 0;// Score position as draw if it repeats
+        if(pos.halfmove_clock >= 50) return 0; 
+
+        // Neither side has the material to mate
+        if(probe_material_table(pos).is_draw()) return draw_score;
     }
 
-    
-    // if(pos.is_repetition()) return 0;// Score position as draw if it repeats
-    if(pos.halfmove_clock >= 50) return 0; 
+    if(search_stopped()) return 0;
 
     node_count++;
 
-    MovePicker move_picker(pos);
+    AttackInfo attack_info(pos);
+    MovePicker move_picker(pos, attack_info);
+
+    bool in_check = attack_info.checkers();
 
-    TableEntry table_entry = probe_table(pos.position_key);
-    if(table_entry.info != 0){
-        if(pos.is_pseudolegal(table_entry.move)) {
-            move_picker.add_move(table_entry.move);
+    // Set if this is the search for a singular extension, the entry of the node is not used then
+    Move excluded_move = search_stack[ply].excluded_move;
+
+    // Extensions stop after twice the depth of the iteration and before the end of the stack
+    auto can_extend = [&](){return (ply < 2*root_depth) && (ply + depth < max_search_ply - 2);};
+
+    // Check extension, the root keeps the depth of the iteration
+    if(!root_node && in_check && can_extend()){
+        depth++;
+        search_stats.check_extensions++;
+    }
+
+    // The root moves are ordered already and the root must not be cut off
+    TableEntry table_entry = (root_node || excluded_move) ? TableEntry() : probe_table(pos.position_key);
+    if(table_entry.validation_key){
+        table_entry.score = score_from_table(table_entry.score, ply);
+
+        // A PV node is searched on to get its PV, only positions of the game end it
+        if(((table_entry.info&entry_flag_mask) == const_entry) && ((table_entry.info&entry_dep_mask) >= depth)){
+            return table_entry.score;
         }
-        if((table_entry.info&entry_dep_mask) >= depth){
-            //score = table_entry.score;
 
+        if(!pv_node && ((table_entry.info&entry_dep_mask) >= depth)){
             switch (table_entry.info&entry_flag_mask)
             {
             case lower_bound:
@@ -342,19 +756,131 @@ int search(int alpha, int beta, int depth){
                 else if(table_entry.score <= alpha) return alpha;
                 else return table_entry.score;
                 break;
-            case const_entry:
-                return table_entry.score;
             default:
                 break;
             }
         }
+        // Only validated if there was no cutoff
+        move_picker.add_tt_move(table_entry.move);
     }
 
-    Move move = move_picker.pick_next_move();
+    int static_eval = in_check ? no_eval : eval();
+    search_stack[ply].static_eval = static_eval;
+
+    // Better than two plies ago, when this side was last to move
+    bool improving = (ply >= 2) && (static_eval > search_stack[ply - 2].static_eval);
+
+    // None of this is done at the root, in check or close to mate scores
+    if(!root_node && !in_check && !excluded_move && (beta < mate_score_bound) && (alpha > -mate_score_bound)){
+        // Reverse futility: so far above beta that a move will not lose it all
+        if((depth <= reverse_futility_depth)
+           && (static_eval - reverse_futility_margin*(depth - improving) >= beta)){
+            search_stats.reverse_futility++;
+            return beta;
+        }
+
+        // Razoring: so far below alpha that only captures could help
+        if((depth <= razoring_depth) && (static_eval + razoring_margin[depth] <= alpha)){
+            if(qs_search(alpha, beta, 0, ply) <= alpha){
+                search_stats.razoring++;
+                return alpha;
+            }
+        }
+
+        // ProbCut: a good capture that beats a raised beta, first in the QS
+        // and then in a reduced search, will very likely beat beta as well.
+        // A PV node needs the exact score, so only null windows are cut
+        int probcut_beta = beta + probcut_margin;
+
+        if(!pv_node && (depth >= probcut_depth) && (probcut_beta < mate_score_bound)){
+            MovePicker probcut_picker(pos, attack_info);
+            probcut_picker.set_qs();
+
+            while(Move move = probcut_picker.pick_next_move()){
+                if(!see_ge(pos, move, probcut_beta - static_eval)) continue;
+
+                make_move(pos, move);
+
+                // The QS only weeds out the captures that do not hold, no checks needed
+                int score = -qs_search(-probcut_beta, -probcut_beta + 1, 1, ply + 1);
+
+                if(score == -illegal_position){
+                    unmake_move(pos);
+                    continue;
+                }
+
+                if(score >= probcut_beta){
+                    score = -search<NonPV>(-probcut_beta, -probcut_beta + 1, depth - probcut_reduction, ply + 1);
+                }
+
+                unmake_move(pos);
+
+                if(search_stopped()) return 0;
+
+                if(score >= probcut_beta){
+                    store_entry(pos.position_key, move, score_to_table(score, ply), lower_bound, depth - probcut_reduction + 1);
+                    search_stats.probcut++;
+                    return beta;
+                }
+            }
+        }
+    }
+
+    // Singular extension: the TT move is a lower bound and all other moves
+    // fail low against a bound below its score in a shallower search. Not
+    // in check, that search on the same ply would extend the check again
+    Move tt_move = table_entry.move;
+    bool singular = false;
+
+    if(!root_node && !in_check && (depth >= singular_depth) && tt_move && can_extend()
+       && (((table_entry.info&entry_flag_mask) == lower_bound) || ((table_entry.info&entry_flag_mask) == exact_score))
+       && ((table_entry.info&entry_dep_mask) >= depth - 3)
+       && (abs(table_entry.score) < mate_score_bound)
+       && pos.is_pseudolegal(tt_move)){
+
+        int singular_beta = table_entry.score - singular_margin*depth;
+
+        search_stack[ply].excluded_move = tt_move;
+        int score = search<NonPV>(singular_beta - 1, singular_beta, (depth - 1)/2, ply);
+        search_stack[ply].excluded_move = 0;
+
+        if(search_stopped()) return 0;
+
+        // The search ran on the same ply
+        search_stack[ply].static_eval = static_eval;
+
+        search_stats.singular_searches++;
+        if(score < singular_beta){
+            singular = true;
+            search_stats.singular_extensions++;
+        }
+    }
+
+    // Quiet moves that do not check are skipped if alpha is above this
+    int futility_eval = (!root_node && !in_check && (depth <= futility_depth)) ? static_eval + futility_margin[depth] : infinity_score;
+
+    // The root takes its moves from root_moves, starting at the line
+    size_t root_index = pv_line;
+    RootMove* root_move = nullptr;
+
+    auto next_move = [&]() -> Move {
+        if constexpr(root_node){
+            // Illegal moves have been found by the first line
+            while((root_index < root_moves.size()) && (root_moves[root_index].score == -illegal_position)) root_index++;
+            if(root_index == root_moves.size()) return 0;
+
+            root_move = &root_moves[root_index++];
+            return root_move->move;
+        }
+        else return move_picker.pick_next_move();
+    };
+
+    Move move = next_move();
     Move best_move = 0;
 
 
     short moves_played = 0;
+    bool pruned = false;
 
     EntryFlags flag = upper_bound;
 
@@ -362,23 +888,55 @@ int search(int alpha, int beta, int depth){
 
     while(move){;
 
+        if(move == excluded_move){
+            move = next_move();
+            continue;
+        }
+
+        // Futility pruning, en passant and promotions are not quiet
+        if((futility_eval <= alpha) && (alpha > -mate_score_bound)
+           && !pos.board[to_square(move)] && ((move&0x7000) <= 0x1000) && !attack_info.gives_check(move)){
+            search_stats.futility++;
+            pruned = true;
+            move = next_move();
+            continue;
+        }
+
+        unsigned long long nodes_before = node_count + qs_node_count;
+
         make_move(pos, move);
 
-        assert(pos.piece_bitboards[w_king] != 0ULL);
-        assert(pos.piece_bitboards[b_king] != 0ULL);
+        assert(pos.pieces(w_king) != 0ULL);
+        assert(pos.pieces(b_king) != 0ULL);
+
+        int new_depth = depth - 1 + (singular && (move == tt_move));
 
-        score = -search(-beta, -alpha, depth - 1);
+        // After the first move a PV node only checks if a move beats alpha,
+        // the ones that do are searched again with the whole window
+        if(!pv_node || moves_played){
+            score = -search<NonPV>(-alpha - 1, -alpha, new_depth, ply + 1);
+
+            if(pv_node && (score > alpha) && (score < beta) && !search_stopped()){
+                score = -search<PV>(-beta, -alpha, new_depth, ply + 1);
+            }
+        }
+        else score = -search<PV>(-beta, -alpha, new_depth, ply + 1);
         //score += incremental_eval(pos, move);
 
+        if constexpr(root_node) root_move->nodes = node_count + qs_node_count - nodes_before;
+
         if(score == -illegal_position){
                 // If the move was illegal, just undo and search the next one
                 unmake_move(pos);
-                move = move_picker.pick_next_move();
+                if constexpr(root_node) root_move->score = -illegal_position;
+                move = next_move();
                 continue;
             }
 
         unmake_move(pos);
 
+        if(search_stopped()) return 0;
+
         moves_played++;
 
 
@@ -388,7 +946,7 @@ int search(int alpha, int beta, int depth){
             // If beta is exceeded as well, perform beta cutoff
             if(score >= beta){
 
-                store_entry(pos.position_key, move, score, lower_bound, depth);
+                if(!root_node && !excluded_move) store_entry(pos.position_key, move, score_to_table(score, ply), lower_bound, depth);
 
                 return beta;
             }
@@ -398,26 +956,30 @@ int search(int alpha, int beta, int depth){
             // Alpha was raised, potential PV-Node
             flag = exact_score;
 
-            principal_variation[max_pv_len*depth] = best_move = move;
-            
-            
-            std::copy_n(  &principal_variation[(max_pv_len*(depth - 1))],
-                        depth-1,
-                        &principal_variation[(max_pv_len*depth) + 1]);
-        
+            best_move = move;
 
+            if constexpr(pv_node) update_pv(ply, move);
+
+            if constexpr(root_node){
+                root_move->score = score;
+                std::copy_n(&principal_variation[0], pv_length[0], &root_move->pv[0]);
+                root_move->pv_length = pv_length[0];
+            }
         }
 
-        move = move_picker.pick_next_move();
+        move = next_move();
 
     }
     if(moves_played == 0){
-        if(get_checkers(pos.to_move, pos)) return -(checkmate_score + depth);
+        // Not a stalemate if moves were skipped, with the excluded move it is singular
+        if(pruned || excluded_move) return alpha;
+        if(in_check) return -checkmate_score + ply;
         return stalemate_score;
     }
     // TODO: ONLY POSSIBLE MOVE FLAG, then play move instantly
 
-    store_entry(pos.position_key, best_move, alpha, flag, depth);
+    // The entry of the root is stored after all lines
+    if(!root_node && !excluded_move) store_entry(pos.position_key, best_move, score_to_table(alpha, ply), flag, depth);
     return alpha;
 }
 
@@ -430,8 +992,9 @@ void prepare_tables(const Position& position){
     // 78 = opening material
     // 30 = endgame material
     float scaler = (78 - total_material)/78.0f;
-    std::cout << "Game Phase: " << scaler << std::endl;
+    if(!pondering) std::cout << "Game Phase: " << scaler << std::endl;
 
+    // Only for the move ordering, the eval mixes the tables with the phase of each position
     for(int i = 0; i < pos_table_size; i++){
         piece_square_tbl[i] = static_cast<uint8_t>(
                             piece_square_tbl_endgame[i]*scaler
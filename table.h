@@ -37,7 +37,50 @@ void store_entry(uint64_t key, Move move, int score, EntryFlags flag, int depth)
     }
 }
 
+// The QS probes and stores only in builds with -DQS_TABLE. It saves 5-10%
+// of the QS nodes, but the probes miss the cache and are slower
+// than searching the captures again
+#ifdef QS_TABLE
+constexpr bool use_qs_table = true;
+#else
+constexpr bool use_qs_table = false;
+#endif
+
+// QS results are stored with depth 0. They only take empty slots and slots
+// of other QS results, entries of the main search are never replaced
+void store_qs_entry(uint64_t key, Move move, int score, EntryFlags flag){
+
+    assert((key >> tbl_shift) < tbl_size);
+
+    TableEntry& entry = transp_table[key >> tbl_shift];
+
+    // Constant entries have a depth as well, so they are kept too
+    if((entry.info&entry_dep_mask) == 0){
+        entry = TableEntry(key, move, score, flag);
+    }
+}
+
+// Starts loading the slot of a key, so it is in the cache once it is probed
+inline void prefetch_entry(uint64_t key){
+    __builtin_prefetch(&transp_table[key >> tbl_shift]);
+}
+
+// Mate scores are stored as the distance from the node instead of the root,
+// the same position can be reached at another ply
+inline int score_to_table(int score, int ply){
+    if(score >= mate_score_bound) return score + ply;
+    if(score <= -mate_score_bound) return score - ply;
+    return score;
+}
+
+inline int score_from_table(int score, int ply){
+    if(score >= mate_score_bound) return score - ply;
+    if(score <= -mate_score_bound) return score + ply;
+    return score;
+}
+
 // Returns a zero entry if no hit, otherwise the entry
+// A QS lower bound has info 0, so hits are told apart by the validation key
 TableEntry probe_table(uint64_t key){
 
     assert((key >> tbl_shift) < tbl_size);
@@ -51,5 +94,43 @@ TableEntry probe_table(uint64_t key){
 }
 
 
+// EVAL CACHE:
+
+/*
+Static evals by position key, so transpositions and the positions of
+earlier iterations do not evaluate again. An entry is one word: the upper
+48 bits of the key and the eval as int16 in the lower 16 bits. It is
+written and read in one piece, so a hit can never mix two positions and
+no lock is needed if more threads use it. The index takes the low bits of
+the key, which the check does not need to compare.
+*/
+constexpr short eval_cache_idx_len = 16;
+constexpr unsigned long eval_cache_size = 1UL << eval_cache_idx_len;
+
+// 65536 entries, 512 KB
+static std::array<uint64_t, eval_cache_size> eval_cache;
+
+unsigned long long eval_cache_probes;
+unsigned long long eval_cache_hits;
+
+inline void prefetch_eval_cache(uint64_t key){
+    __builtin_prefetch(&eval_cache[key & (eval_cache_size - 1)]);
+}
+
+// Returns true and sets score on a hit
+inline bool probe_eval_cache(uint64_t key, int& score){
+    uint64_t entry = eval_cache[key & (eval_cache_size - 1)];
+
+    eval_cache_probes++;
+    if((entry ^ key) >> 16) return false;
+
+    eval_cache_hits++;
+    score = static_cast<int16_t>(entry & 0xFFFF);
+    return true;
+}
+
+inline void store_eval_cache(uint64_t key, int score){
+    eval_cache[key & (eval_cache_size - 1)] = (key & ~0xFFFFULL) | static_cast<uint16_t>(score);
+}
 
 #endif // TABLE_H
\ No newline at end of file
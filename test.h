@@ -238,9 +238,8 @@ std::string convert_to_algebraic(Move move, Position& pos, bool check_sign){
     }
 
     if(check_sign){
-        make_move(pos, move);
-        if(get_checkers(pos.to_move, pos)) result += "+";
-        unmake_move(pos);
+        AttackInfo attack_info(pos);
+        if(attack_info.gives_check(move)) result += "+";
     }
     
 
@@ -255,7 +254,7 @@ std::string resolve_ambigous(Square from, Square to, PieceType p_type, const Pos
     std::string rank_labels = "12345678";
 
     Bitboard target = 1ULL << to;
-    Bitboard possible_attackers = pos.piece_bitboards[p_type | pos.to_move];
+    Bitboard possible_attackers = pos.pieces(p_type | pos.to_move);
     Bitboard ambig_pieces = 0ULL;
 
     while(possible_attackers){
@@ -267,14 +266,14 @@ std::string resolve_ambigous(Square from, Square to, PieceType p_type, const Pos
         if((p_type == knight) && (knight_attacks[sq]&target)){
             ambig_pieces |= 1ULL << sq;
         }
-        else if((p_type == bishop) && (get_bishop_attack_BB(sq, ~pos.piece_bitboards[no_piece])&target)){
+        else if((p_type == bishop) && (get_bishop_attack_BB(sq, pos.occupied())&target)){
             ambig_pieces |= 1ULL << sq; // Bishop ambiguity can only happen after promotion 
         }
-        else if((p_type == rook) && (get_rook_attack_BB(sq, ~pos.piece_bitboards[no_piece])&target)){
+        else if((p_type == rook) && (get_rook_attack_BB(sq, pos.occupied())&target)){
             ambig_pieces |= 1ULL << sq;
         }
-        else if((p_type == queen) && ((get_rook_attack_BB(sq, ~pos.piece_bitboards[no_piece])&target) ||
-                                    (get_bishop_attack_BB(sq, ~pos.piece_bitboards[no_piece])&target)) ){
+        else if((p_type == queen) && ((get_rook_attack_BB(sq, pos.occupied())&target) ||
+                                    (get_bishop_attack_BB(sq, pos.occupied())&target)) ){
             ambig_pieces |= 1ULL << sq;
         }
 
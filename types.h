@@ -73,6 +73,22 @@ enum Colors
     white = 0,
 };
 
+// Compile time helpers for code that is specialized on the side to move
+template <PieceColor side> constexpr PieceColor opponent = (side == white) ? black : white;
+
+// Castling constants of one side, so qkQK does not have to be picked at runtime
+template <PieceColor side> constexpr uint8_t cstl_side     = (side == white) ? cstl_w : cstl_b;
+template <PieceColor side> constexpr uint8_t cstl_kingside  = (side == white) ? cstl_K : cstl_k;
+template <PieceColor side> constexpr uint8_t cstl_queenside = (side == white) ? cstl_Q : cstl_q;
+
+template <PieceColor side> constexpr uint64_t cstl_squares_kingside   = (side == white) ? cstl_squares_K : cstl_squares_k;
+template <PieceColor side> constexpr uint64_t cstl_squares_queenside  = (side == white) ? cstl_squares_Q : cstl_squares_q;
+template <PieceColor side> constexpr uint64_t cstl_traverse_kingside  = (side == white) ? cstl_traverse_K : cstl_traverse_k;
+template <PieceColor side> constexpr uint64_t cstl_traverse_queenside = (side == white) ? cstl_traverse_Q : cstl_traverse_q;
+
+template <PieceColor side> constexpr uint16_t cstl_move_kingside  = (side == white) ? cstl_move_K : cstl_move_k;
+template <PieceColor side> constexpr uint16_t cstl_move_queenside = (side == white) ? cstl_move_Q : cstl_move_q;
+
 // This is also the mapping of the Bitboards
 // PieceBitboards&type_mask = PieceType
 // Piece
@@ -213,16 +229,18 @@ struct UndoObject
     uint8_t halfmove_clock;
     
     uint64_t position_key;
+    uint64_t pawn_key;
     
 
-    UndoObject(Piece moved, Piece target, Move m, Square enp_sq, uint8_t cstl, uint8_t clock, uint64_t pos_key) : 
+    UndoObject(Piece moved, Piece target, Move m, Square enp_sq, uint8_t cstl, uint8_t clock, uint64_t pos_key, uint64_t pawn_key) : 
                 moved_piece(moved),
                 target_piece(target), 
                 move(m), 
                 en_passant_sq(enp_sq), 
                 castling_rights(cstl),
                 halfmove_clock(clock),
-                position_key(pos_key) {}
+                position_key(pos_key),
+                pawn_key(pawn_key) {}
     
     UndoObject() {};
 };
@@ -237,6 +255,10 @@ enum SpecialScore{
     mate_dep_margin = 200
 };
 
+// Being mated at ply p from the root scores -checkmate_score + p. No line
+// is longer than mate_dep_margin plies, so all scores above the bound are mates
+constexpr int mate_score_bound = checkmate_score - mate_dep_margin;
+
 constexpr uint8_t empty_move = 0;
 
 
@@ -1,6 +1,8 @@
 #ifndef UTILITY_H
 #define UTILITY_H
 
+#include <array>
+
 #include "types.h"
 
 /*
@@ -62,6 +64,40 @@ constexpr static Bitboard file_array[8] = { __A_FILE,
                                             __G_FILE,
                                             __H_FILE};
 
+// Pawn structure masks, the ones for a color are indexed by [color >> 3][square]
+
+// Files left and right of a file
+static constexpr auto adjacent_files{[]() constexpr{
+    std::array<Bitboard, 8> result{};
+    for(int file = 0; file < 8; file++){
+        if(file > 0) result[file] |= file_array[file - 1];
+        if(file < 7) result[file] |= file_array[file + 1];
+    }
+    return result;
+}()};
+
+// Squares in front of a pawn on its own file, seen from its color
+static constexpr auto front_span{[]() constexpr{
+    std::array<std::array<Bitboard, 64>, 2> result{};
+    for(int sq = 0; sq < 64; sq++){
+        for(int rank = sq/8 + 1; rank < 8; rank++) result[0][sq] |= file_array[sq%8] & rank_array[rank];
+        for(int rank = sq/8 - 1; rank >= 0; rank--) result[1][sq] |= file_array[sq%8] & rank_array[rank];
+    }
+    return result;
+}()};
+
+// The pawn is passed if there are no enemy pawns on these squares, the front
+// span and the squares in front of it on the adjacent files
+static constexpr auto passed_pawn_mask{[]() constexpr{
+    std::array<std::array<Bitboard, 64>, 2> result{};
+    for(int sq = 0; sq < 64; sq++){
+        Bitboard files = file_array[sq%8] | adjacent_files[sq%8];
+        for(int rank = sq/8 + 1; rank < 8; rank++) result[0][sq] |= files & rank_array[rank];
+        for(int rank = sq/8 - 1; rank >= 0; rank--) result[1][sq] |= files & rank_array[rank];
+    }
+    return result;
+}()};
+
 
 // FAST BIT PARSING
 // get lsb and count bits set use gcc builtin functions